@@ -0,0 +1,109 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "./replacement.h"
+#include "./wall_clock.h"
+
+// L2 sized level: NUM_LOOKUPS lookups per associativity, about half of them hits
+#define BENCH_ENTRIES (1 << 14)
+#define NUM_LOOKUPS (1 << 24)
+
+
+/**
+ * Fill every way with a distinct tag, leave a few ways invalid
+*/
+static void fill_level(CacheLevel* level) {
+    unsigned int seed = 1;
+    size_t entries = level->num_sets * level->associativity;
+    for (size_t i = 0; i < entries; i++) {
+        if (rand_r(&seed) % 8 != 0) {
+            level_fill(level, i / level->associativity, i % level->associativity, i);
+        }
+    }
+}
+
+
+/**
+ * Lookup keys: set in the low half, tag that hits about half of the time
+*/
+static void make_keys(const CacheLevel* level, size_t* sets, int* tags) {
+    unsigned int seed = 2;
+    for (size_t i = 0; i < NUM_LOOKUPS; i++) {
+        size_t set = rand_r(&seed) % level->num_sets;
+        size_t way = rand_r(&seed) % (level->associativity * 2);
+        sets[i] = set;
+        tags[i] = set * level->associativity + way;
+    }
+}
+
+
+/**
+ * Microbenchmark of level_lookup against level_lookup_scalar and the tag
+ * index of wide levels
+ * make bench-lookup && ./bench_lookup
+*/
+int main() {
+    size_t* sets = malloc(NUM_LOOKUPS * sizeof(size_t));
+    int* tags = malloc(NUM_LOOKUPS * sizeof(int));
+    if (!sets || !tags) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    printf("Ways | Scalar (M/s) | Vector (M/s) | Speedup | Indexed (M/s) | Speedup\n");
+    printf("-----|--------------|--------------|---------|---------------|--------\n");
+
+    static const unsigned long int ways[] = { 1, 2, 4, 8, 12, 16, 24, 32, 48, 64, 128, 256, 1024, 4096 };
+    for (size_t w = 0; w < sizeof(ways) / sizeof(ways[0]); w++) {
+        CacheLevel level;
+        init_level(&level, BENCH_ENTRIES / ways[w], ways[w], 64, 0, POLICY_RANDOM);
+        fill_level(&level);
+        make_keys(&level, sets, tags);
+
+        long scalar_sum = 0;
+        double start = now_seconds();
+        for (size_t i = 0; i < NUM_LOOKUPS; i++) {
+            scalar_sum += level_lookup_scalar(&level, sets[i], tags[i]);
+        }
+        double scalar_seconds = now_seconds() - start;
+
+        long vector_sum = 0;
+        start = now_seconds();
+        for (size_t i = 0; i < NUM_LOOKUPS; i++) {
+            vector_sum += level_lookup(&level, sets[i], tags[i]);
+        }
+        double vector_seconds = now_seconds() - start;
+
+        CacheLevel indexed;
+        init_level(&indexed, BENCH_ENTRIES / ways[w], ways[w], 64, 0, POLICY_RANDOM);
+        level_enable_index(&indexed);
+        fill_level(&indexed);
+
+        long indexed_sum = 0;
+        start = now_seconds();
+        for (size_t i = 0; i < NUM_LOOKUPS; i++) {
+            indexed_sum += level_lookup(&indexed, sets[i], tags[i]);
+        }
+        double indexed_seconds = now_seconds() - start;
+
+        if (scalar_sum != vector_sum || scalar_sum != indexed_sum) {
+            fprintf(stderr, "Error: lookups disagree at %lu ways\n", ways[w]);
+            exit(1);
+        }
+
+        char vector_speedup[16];
+        snprintf(vector_speedup, sizeof(vector_speedup), "%.2fx", scalar_seconds / vector_seconds);
+        printf("%-4lu | %-12.1f | %-12.1f | %-7s | %-13.1f | %.2fx\n", ways[w],
+            NUM_LOOKUPS / scalar_seconds / 1e6, NUM_LOOKUPS / vector_seconds / 1e6,
+            vector_speedup, NUM_LOOKUPS / indexed_seconds / 1e6, scalar_seconds / indexed_seconds);
+        free_level(&level);
+        free_level(&indexed);
+    }
+
+    free(sets);
+    free(tags);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "./synthetic.h"
+#include "./wall_clock.h"
+
+// references per generator, generated in memory before timing
+#define BENCH_RECORDS (1 << 22)
+
+// data footprint of every generator, 16x the default L2
+#define BENCH_FOOTPRINT (4 * 1024 * 1024)
+
+#define BENCH_SEED 42
+
+// configurations every generator runs through
+typedef struct {
+    const char* name;
+    const char* spec;           // parse_config keys over the defaults
+    int tags_only;
+} BenchConfig;
+
+static const BenchConfig BENCH_CONFIGS[] = {
+    { "original", "", 0 },
+    { "original tags", "", 1 },
+    { "lru + L3 tags", "l1d-ways=8:l1d-policy=lru:l2-size=1M:l2-ways=16:l2-policy=lru:l3-size=8M:l3-ways=16:l3-policy=srrip", 1 },
+};
+
+
+/**
+ * Simulator throughput on every synthetic generator, no trace files involved
+ * make bench, or ./bench_sim [records]
+*/
+int main(int argc, char* argv[]) {
+    size_t num_records = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_RECORDS;
+    if (num_records == 0) {
+        fprintf(stderr, "Usage: %s [records]\n", argv[0]);
+        return 1;
+    }
+
+    TraceRecord* records = malloc(num_records * sizeof(TraceRecord));
+    if (!records) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    printf("%zu references per generator, %d KB data footprint\n\n", num_records, BENCH_FOOTPRINT / 1024);
+    printf("Generator     | Configuration | M refs/s | ns/access | L1 hit rate | L2 hit rate\n");
+    printf("--------------|---------------|----------|-----------|-------------|------------\n");
+
+    size_t num_configs = sizeof(BENCH_CONFIGS) / sizeof(BENCH_CONFIGS[0]);
+    double total_seconds = 0;
+    for (int kind = 0; kind < NUM_SYNTHETIC; kind++) {
+        SyntheticTrace gen;
+        synthetic_init(&gen, kind, BENCH_FOOTPRINT, BENCH_SEED);
+        synthetic_fill(&gen, records, num_records);
+        synthetic_free(&gen);
+
+        for (size_t c = 0; c < num_configs; c++) {
+            CacheConfig config;
+            default_config(&config);
+            config.tags_only = BENCH_CONFIGS[c].tags_only;
+            if (BENCH_CONFIGS[c].spec[0] && parse_config(BENCH_CONFIGS[c].spec, &config) != 0) {
+                fprintf(stderr, "Error: Invalid benchmark configuration %s\n", BENCH_CONFIGS[c].spec);
+                exit(1);
+            }
+            CacheSim* sim = create_simulator(&config);
+
+            double start = now_seconds();
+            simulate_records(sim, records, num_records);
+            double seconds = now_seconds() - start;
+            total_seconds += seconds;
+
+            const CacheStats* stats = &sim->stats;
+            unsigned long int l1_hits = stats->l1_icache_hits + stats->l1_dcache_hits;
+            unsigned long int l1_accesses = l1_hits + stats->l1_icache_misses + stats->l1_dcache_misses;
+            unsigned long int l2_accesses = stats->l2_hits + stats->l2_misses;
+            printf("%-13s | %-13s | %-8.2f | %-9.1f | %-11.4f | %.4f\n",
+                synthetic_name(kind), BENCH_CONFIGS[c].name, num_records / seconds / 1e6,
+                seconds * 1e9 / num_records, l1_accesses ? (double) l1_hits / l1_accesses : 0,
+                l2_accesses ? (double) stats->l2_hits / l2_accesses : 0);
+            destroy_simulator(sim);
+        }
+    }
+
+    size_t runs = NUM_SYNTHETIC * num_configs;
+    printf("\n%zu runs, %.2f M refs/s overall\n", runs, runs * num_records / total_seconds / 1e6);
+
+    free(records);
+    return 0;
+}
@@ -0,0 +1,301 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./cache_level.h"
+#include "./replacement.h"
+
+
+/**
+ * Allocate or die
+*/
+static void* level_alloc(size_t size) {
+    void* p = malloc(size);
+    if (!p) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+
+/**
+ * Words in a bit array over every entry
+*/
+static size_t bit_words(const CacheLevel* level) {
+    return (level->num_sets * level->associativity + 63) / 64;
+}
+
+
+/**
+ * log2 of a power of two
+*/
+static unsigned int log2_exact(unsigned long int value) {
+    return __builtin_ctzl(value);
+}
+
+
+/**
+ * Allocate a level, payload only if with_data is set.
+ * block_size must be a power of two and the policy must pass policy_check
+ * for this associativity. The level starts out cold.
+*/
+void init_level(CacheLevel* level, unsigned long int num_sets, unsigned long int associativity,
+                unsigned long int block_size, int with_data, int policy) {
+    level->num_sets = num_sets;
+    level->associativity = associativity;
+    level->block_size = block_size;
+
+    level->block_shift = log2_exact(block_size);
+    level->sets_pow2 = (num_sets & (num_sets - 1)) == 0;
+    level->set_shift = level->sets_pow2 ? log2_exact(num_sets) : 0;
+    level->set_mask = num_sets - 1;
+
+    level->policy = policy;
+    level->field_bits = policy_field_bits(policy, associativity);
+    level->state_words = (policy_fields(policy, associativity) * level->field_bits + 63) / 64;
+    level->policy_state = level_alloc((num_sets * level->state_words + 1) * sizeof(uint64_t));
+
+    size_t entries = num_sets * associativity;
+    level->tags = level_alloc(entries * sizeof(int));
+    level->valid = level_alloc(bit_words(level) * sizeof(uint64_t));
+    level->dirty = level_alloc(bit_words(level) * sizeof(uint64_t));
+    level->data = with_data ? level_alloc(entries * block_size) : NULL;
+    level->prefetched = NULL;
+    level->ready = NULL;
+    level->index = NULL;
+    level->invalid_from = NULL;
+    level->lru_prev = NULL;
+    level->lru_next = NULL;
+    level->lru_head = NULL;
+    level->lru_tail = NULL;
+
+    reset_level(level);
+}
+
+
+/**
+ * Invalidate every way
+*/
+void reset_level(CacheLevel* level) {
+    size_t entries = level->num_sets * level->associativity;
+    for (size_t i = 0; i < entries; i++) {
+        level->tags[i] = -1;
+    }
+    memset(level->valid, 0, bit_words(level) * sizeof(uint64_t));
+    memset(level->dirty, 0, bit_words(level) * sizeof(uint64_t));
+    if (level->data) {
+        memset(level->data, 0, entries * level->block_size);
+    }
+    if (level->prefetched) {
+        memset(level->prefetched, 0, bit_words(level) * sizeof(uint64_t));
+        memset(level->ready, 0, entries * sizeof(double));
+    }
+    if (level->index) {
+        memset(level->index, 0, level->num_sets * level->index_size * sizeof(uint32_t));
+        memset(level->invalid_from, 0, level->num_sets * sizeof(uint32_t));
+        level->duplicates = 0;
+    }
+    policy_reset(level);
+}
+
+
+/**
+ * Keep track of prefetched blocks in a level
+*/
+void level_enable_prefetch(CacheLevel* level) {
+    size_t entries = level->num_sets * level->associativity;
+    level->prefetched = level_alloc(bit_words(level) * sizeof(uint64_t));
+    level->ready = level_alloc(entries * sizeof(double));
+    memset(level->prefetched, 0, bit_words(level) * sizeof(uint64_t));
+    memset(level->ready, 0, entries * sizeof(double));
+}
+
+
+/**
+ * Look tags up through a hash index instead of scanning the set, and keep
+ * LRU as a list instead of packed ages, so an access costs the same at any
+ * associativity. The level starts out cold again.
+*/
+void level_enable_index(CacheLevel* level) {
+    level->index_size = 2;
+    while (level->index_size < 2 * level->associativity) {
+        level->index_size <<= 1;
+    }
+    level->index_shift = 64 - log2_exact(level->index_size);
+    level->index = level_alloc(level->num_sets * level->index_size * sizeof(uint32_t));
+    level->invalid_from = level_alloc(level->num_sets * sizeof(uint32_t));
+
+    if (level->policy == POLICY_LRU) {
+        size_t entries = level->num_sets * level->associativity;
+        level->lru_prev = level_alloc(entries * sizeof(uint32_t));
+        level->lru_next = level_alloc(entries * sizeof(uint32_t));
+        level->lru_head = level_alloc(level->num_sets * sizeof(uint32_t));
+        level->lru_tail = level_alloc(level->num_sets * sizeof(uint32_t));
+
+        // the list replaces the ages
+        level->state_words = 0;
+    }
+
+    reset_level(level);
+}
+
+
+/**
+ * Add a valid way to the index of its set
+*/
+static void index_insert(CacheLevel* level, size_t set, size_t way) {
+    uint32_t* slots = &level->index[set * level->index_size];
+    const int* tags = &level->tags[set * level->associativity];
+    int tag = tags[way];
+    size_t mask = level->index_size - 1;
+
+    size_t slot = level_index_home(level, tag);
+    for (; slots[slot]; slot = (slot + 1) & mask) {
+        if (tags[slots[slot] - 1] == tag) {
+            // another way holds the tag too, the lookup finds the lowest
+            level->duplicates++;
+            if (way < slots[slot] - 1) {
+                slots[slot] = way + 1;
+            }
+            return;
+        }
+    }
+    slots[slot] = way + 1;
+}
+
+
+/**
+ * Take a valid way out of the index of its set, before its tag changes
+*/
+static void index_remove(CacheLevel* level, size_t set, size_t way) {
+    uint32_t* slots = &level->index[set * level->index_size];
+    const int* tags = &level->tags[set * level->associativity];
+    size_t base = set * level->associativity;
+    int tag = tags[way];
+    size_t mask = level->index_size - 1;
+
+    size_t slot = level_index_home(level, tag);
+    while (slots[slot] && tags[slots[slot] - 1] != tag) {
+        slot = (slot + 1) & mask;
+    }
+    if (slots[slot] != way + 1) {
+        return;
+    }
+
+    // hand the slot to the next valid way holding the tag, if any ever did
+    if (level->duplicates) {
+        for (size_t w = way + 1; w < level->associativity; w++) {
+            if (tags[w] == tag && level_bit(level->valid, base + w)) {
+                slots[slot] = w + 1;
+                return;
+            }
+        }
+    }
+
+    // empty the slot, moving later entries of the probe run back into it
+    size_t next = (slot + 1) & mask;
+    while (slots[next]) {
+        size_t home = level_index_home(level, tags[slots[next] - 1]);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            slots[slot] = slots[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    slots[slot] = 0;
+}
+
+
+/**
+ * level_fill of an indexed level
+*/
+void level_index_fill(CacheLevel* level, size_t set, size_t way, int tag) {
+    size_t entry = level_entry(level, set, way);
+    if (level_bit(level->valid, entry)) {
+        if (level->tags[entry] == tag) {
+            return;
+        }
+        index_remove(level, set, way);
+    }
+    level_set_bit(level->valid, entry, 1);
+    level->tags[entry] = tag;
+    index_insert(level, set, way);
+}
+
+
+/**
+ * level_invalidate of an indexed level
+*/
+void level_index_invalidate(CacheLevel* level, size_t set, size_t way) {
+    size_t entry = level_entry(level, set, way);
+    if (!level_bit(level->valid, entry)) {
+        return;
+    }
+    index_remove(level, set, way);
+    level_set_bit(level->valid, entry, 0);
+    if (way < level->invalid_from[set]) {
+        level->invalid_from[set] = way;
+    }
+}
+
+
+/**
+ * First invalid way of an indexed level's set, -1 if the set is full.
+ * Starts at invalid_from and moves it up, so filling a set scans it once.
+*/
+long level_index_invalid(CacheLevel* level, size_t set) {
+    size_t base = set * level->associativity;
+    size_t way = level->invalid_from[set];
+    while (way < level->associativity && level_bit(level->valid, base + way)) {
+        way++;
+    }
+    level->invalid_from[set] = way;
+    return way < level->associativity ? (long) way : -1;
+}
+
+
+/**
+ * Free a level's arrays
+*/
+void free_level(CacheLevel* level) {
+    free(level->tags);
+    free(level->valid);
+    free(level->dirty);
+    free(level->data);
+    free(level->policy_state);
+    free(level->prefetched);
+    free(level->ready);
+    free(level->index);
+    free(level->invalid_from);
+    free(level->lru_prev);
+    free(level->lru_next);
+    free(level->lru_head);
+    free(level->lru_tail);
+    memset(level, 0, sizeof(*level));
+}
+
+
+/**
+ * Bytes of simulator memory behind a level
+*/
+size_t level_footprint(const CacheLevel* level) {
+    size_t entries = level->num_sets * level->associativity;
+    size_t bytes = entries * sizeof(int) + 2 * bit_words(level) * sizeof(uint64_t)
+        + level->num_sets * level->state_words * sizeof(uint64_t);
+    if (level->data) {
+        bytes += entries * level->block_size;
+    }
+    if (level->prefetched) {
+        bytes += bit_words(level) * sizeof(uint64_t) + entries * sizeof(double);
+    }
+    if (level->index) {
+        bytes += (level->num_sets * (level->index_size + 1)) * sizeof(uint32_t);
+    }
+    if (level->lru_next) {
+        bytes += 2 * (entries + level->num_sets) * sizeof(uint32_t);
+    }
+    return bytes;
+}
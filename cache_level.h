@@ -0,0 +1,294 @@
+#ifndef CACHE_LEVEL_H
+#define CACHE_LEVEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// widest set level_lookup scans by default, levels with more ways keep a tag
+// index and an LRU list instead (indexed-ways)
+#define DEFAULT_INDEXED_WAYS 64
+
+// one cache level as a structure of arrays
+// way w of set s is entry s * associativity + w in every array,
+// valid and dirty are flat bit arrays over those entries
+typedef struct {
+    unsigned long int num_sets;
+    unsigned long int associativity;
+    unsigned long int block_size;
+
+    // address split: block number = address >> block_shift, then
+    // set = block & set_mask, tag = block >> set_shift when num_sets is a
+    // power of two (sets_pow2), else set = block % num_sets, tag = block / num_sets
+    unsigned int block_shift;
+    unsigned int set_shift;
+    unsigned long int set_mask;
+    int sets_pow2;
+
+    int* tags;
+    uint64_t* valid;
+    uint64_t* dirty;
+
+    // block_size bytes per entry, NULL in tags only mode
+    unsigned long int* data;
+
+    // replacement policy (replacement.h) and its bit packed per-set state,
+    // state_words words per set holding one field_bits wide field per slot
+    int policy;
+    unsigned int field_bits;
+    size_t state_words;
+    uint64_t* policy_state;
+    unsigned int seed;
+
+    // blocks a prefetcher brought in that no demand access used yet (a bit
+    // per entry) and when their fill arrives, NULL for levels without one
+    uint64_t* prefetched;
+    double* ready;
+
+    // tag index of levels wider than indexed-ways (level_enable_index), NULL
+    // for the others: index_size slots per set, open addressed on the tag,
+    // each holding the lowest valid way with that tag + 1, or 0 if empty
+    uint32_t* index;
+    size_t index_size;
+    unsigned int index_shift;       // 64 - log2(index_size)
+    uint32_t* invalid_from;         // per set, no way below it is invalid
+    unsigned long int duplicates;   // fills of a tag another way of the set held, 0 in practice
+
+    // LRU of an indexed level as a list of each set's ways from lru_head
+    // (most recent) to lru_tail, NULL unless the policy is LRU
+    uint32_t* lru_prev;
+    uint32_t* lru_next;
+    uint32_t* lru_head;
+    uint32_t* lru_tail;
+} CacheLevel;
+
+void init_level(CacheLevel* level, unsigned long int num_sets, unsigned long int associativity,
+                unsigned long int block_size, int with_data, int policy);
+void reset_level(CacheLevel* level);
+void level_enable_prefetch(CacheLevel* level);
+void level_enable_index(CacheLevel* level);
+void free_level(CacheLevel* level);
+size_t level_footprint(const CacheLevel* level);
+void level_index_fill(CacheLevel* level, size_t set, size_t way, int tag);
+void level_index_invalidate(CacheLevel* level, size_t set, size_t way);
+long level_index_invalid(CacheLevel* level, size_t set);
+
+
+/**
+ * Set an address maps to
+*/
+static inline size_t level_set_index(const CacheLevel* level, unsigned long int address) {
+    unsigned long int block = address >> level->block_shift;
+    return level->sets_pow2 ? block & level->set_mask : block % level->num_sets;
+}
+
+
+/**
+ * Tag of an address
+*/
+static inline int level_tag(const CacheLevel* level, unsigned long int address) {
+    unsigned long int block = address >> level->block_shift;
+    return level->sets_pow2 ? block >> level->set_shift : block / level->num_sets;
+}
+
+
+/**
+ * Entry index of a way
+*/
+static inline size_t level_entry(const CacheLevel* level, size_t set, size_t way) {
+    return set * level->associativity + way;
+}
+
+static inline int level_bit(const uint64_t* bits, size_t entry) {
+    return bits[entry >> 6] >> (entry & 63) & 1;
+}
+
+static inline void level_set_bit(uint64_t* bits, size_t entry, int value) {
+    uint64_t mask = (uint64_t) 1 << (entry & 63);
+    bits[entry >> 6] = value ? bits[entry >> 6] | mask : bits[entry >> 6] & ~mask;
+}
+
+
+/**
+ * Start loading the tags and valid bits of the set an address maps to
+*/
+static inline void level_prefetch(const CacheLevel* level, unsigned long int address) {
+    size_t base = level_entry(level, level_set_index(level, address), 0);
+    __builtin_prefetch(&level->tags[base]);
+    __builtin_prefetch(&level->valid[base >> 6]);
+}
+
+
+/**
+ * Payload of a way, NULL in tags only mode
+*/
+static inline unsigned long int* level_data(const CacheLevel* level, size_t entry) {
+    return level->data ? (unsigned long int*) ((unsigned char*) level->data + entry * level->block_size) : NULL;
+}
+
+
+/**
+ * Make a way valid with tag, keeping the index in step
+*/
+static inline void level_fill(CacheLevel* level, size_t set, size_t way, int tag) {
+    if (level->index) {
+        level_index_fill(level, set, way, tag);
+        return;
+    }
+    size_t entry = level_entry(level, set, way);
+    level_set_bit(level->valid, entry, 1);
+    level->tags[entry] = tag;
+}
+
+
+/**
+ * Make an entry invalid, its tag stays
+*/
+static inline void level_invalidate(CacheLevel* level, size_t entry) {
+    if (level->index) {
+        level_index_invalidate(level, entry / level->associativity, entry % level->associativity);
+        return;
+    }
+    level_set_bit(level->valid, entry, 0);
+}
+
+
+/**
+ * Valid bits of a set, way w in bit w (associativity <= 64)
+*/
+static inline uint64_t level_valid_mask(const CacheLevel* level, size_t set) {
+    size_t base = set * level->associativity;
+    size_t word = base >> 6;
+    size_t offset = base & 63;
+
+    uint64_t mask = level->valid[word] >> offset;
+    if (offset + level->associativity > 64) {
+        mask |= level->valid[word + 1] << (64 - offset);
+    }
+    if (level->associativity < 64) {
+        mask &= ((uint64_t) 1 << level->associativity) - 1;
+    }
+    return mask;
+}
+
+
+/**
+ * Slot a tag hashes to in its set's index
+*/
+static inline size_t level_index_home(const CacheLevel* level, int tag) {
+    return (uint64_t) (unsigned int) tag * 0x9E3779B97F4A7C15UL >> level->index_shift;
+}
+
+
+/**
+ * Find a valid way holding tag through the set's index, the lowest one
+ * like the scan. Returns the way or -1.
+*/
+static inline long level_index_lookup(const CacheLevel* level, size_t set, int tag) {
+    const uint32_t* slots = &level->index[set * level->index_size];
+    const int* tags = &level->tags[set * level->associativity];
+    size_t mask = level->index_size - 1;
+    for (size_t slot = level_index_home(level, tag); slots[slot]; slot = (slot + 1) & mask) {
+        if (tags[slots[slot] - 1] == tag) {
+            return slots[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Find a valid way holding tag, one way at a time.
+ * Returns the way or -1.
+*/
+static inline long level_lookup_scalar(const CacheLevel* level, size_t set, int tag) {
+    size_t base = set * level->associativity;
+    for (size_t way = 0; way < level->associativity; way++) {
+        if (level_bit(level->valid, base + way) && level->tags[base + way] == tag) {
+            return way;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Find a valid way holding tag.
+ * Compares the set's contiguous tags a vector at a time (AVX-512, AVX2 or
+ * SSE2, whatever the build targets), then masks the matches with the valid
+ * bits. Sets narrower than 4 ways (nothing to vectorize) or wider than 64
+ * ways (too many for the match mask) use the scalar loop.
+ * Returns the way or -1.
+*/
+static inline long level_lookup(const CacheLevel* level, size_t set, int tag) {
+    if (level->index) {
+        return level_index_lookup(level, set, tag);
+    }
+    size_t ways = level->associativity;
+    if (ways < 4 || ways > 64) {
+        return level_lookup_scalar(level, set, tag);
+    }
+
+    const int* tags = &level->tags[set * ways];
+    uint64_t matches = 0;
+    size_t way = 0;
+
+#ifdef __AVX512F__
+    __m512i key16 = _mm512_set1_epi32(tag);
+    for (; way + 16 <= ways; way += 16) {
+        __m512i chunk = _mm512_loadu_si512((const void*) (tags + way));
+        matches |= (uint64_t) _mm512_cmpeq_epi32_mask(chunk, key16) << way;
+    }
+#endif
+#ifdef __AVX2__
+    __m256i key8 = _mm256_set1_epi32(tag);
+    for (; way + 8 <= ways; way += 8) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (tags + way));
+        __m256i equal = _mm256_cmpeq_epi32(chunk, key8);
+        matches |= (uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(equal)) << way;
+    }
+#endif
+#ifdef __SSE2__
+    __m128i key4 = _mm_set1_epi32(tag);
+    for (; way + 4 <= ways; way += 4) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (tags + way));
+        __m128i equal = _mm_cmpeq_epi32(chunk, key4);
+        matches |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(equal)) << way;
+    }
+#endif
+    for (; way < ways; way++) {
+        matches |= (uint64_t) (tags[way] == tag) << way;
+    }
+
+    matches &= level_valid_mask(level, set);
+    return matches ? (long) __builtin_ctzll(matches) : -1;
+}
+
+
+
+/**
+ * First invalid way of a set, -1 if the set is full
+*/
+static inline long level_find_invalid(const CacheLevel* level, size_t set) {
+    if (level->associativity <= 64) {
+        uint64_t invalid = ~level_valid_mask(level, set);
+        if (level->associativity < 64) {
+            invalid &= ((uint64_t) 1 << level->associativity) - 1;
+        }
+        return invalid ? (long) __builtin_ctzll(invalid) : -1;
+    }
+
+    size_t base = set * level->associativity;
+    for (size_t way = 0; way < level->associativity; way++) {
+        if (!level_bit(level->valid, base + way)) {
+            return way;
+        }
+    }
+    return -1;
+}
+
+#endif
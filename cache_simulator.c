@@ -1,690 +1,1282 @@
-#include "./cache_simulator.h"
-
-
-// cache data
-CacheBlock l1_instruction_cache [L1_INSTRUCTION_NUM_BLOCKS];
-CacheBlock l1_data_cache        [L1_DATA_NUM_BLOCKS];
-CacheBlock l2_cache             [NUM_SETS][DEFAULT_ASSOCIATIVITY];
-
-
-unsigned long int SET_ASSOCIATIVITY = -1;
-
-// stats
-unsigned long int l1_icache_misses = 0;
-unsigned long int l1_dcache_misses = 0;
-unsigned long int l2_misses = 0;
-
-unsigned long int l1_icache_hits = 0;
-unsigned long int l1_dcache_hits = 0;
-unsigned long int l2_hits = 0;
-unsigned long int dram_hits = 0;
-
-double l1i_energy = 0;
-double l1d_energy = 0;
-double l2_energy = 0;
-double dram_energy = 0;
-
-unsigned char dram[DRAM_SIZE];
-
-double l1i_static_energy = 0;
-double l1d_static_energy = 0;
-double l2_static_energy = 0;
-double dram_static_energy = 0;
-
-unsigned long int total_mem_acces_time = 0;
-
-// clock
-double simulation_clock = 0;
-
-// function declarations
-void print_title();
-void print_stats();
-void init_caches();
-void process_trace_file(const char* filename);
-void process_dinero_trace(const char* filename);
-
-// simulated accesses
-unsigned long int* read_l1_icache(unsigned long int address);
-unsigned long int* read_l1_dcache(unsigned long int address);
-unsigned long int* read_l2_cache(unsigned long int address);
-unsigned long int* read_dram(unsigned long int address);
-
-// simulated writes
-void write_l1_icache(unsigned long int address, unsigned long int* data);
-void write_l1_dcache(unsigned long int address, unsigned long int* data);
-void write_l2_cache(unsigned long int address, unsigned long int* data);
-void write_dram(unsigned long int address, unsigned long int* data);
-
-// op codes
-void do_memory_read(unsigned long int address);
-void do_memory_write(unsigned long int address, unsigned long int* data);
-void do_instruction_fetch(unsigned long int address, unsigned long int value);
-void do_ignore();
-void do_cache_flush();
-
-// energy sim
-void l1i_idle_energy();
-void l1d_idle_energy();
-void l2_idle_energy();
-void dram_idle_energy();
-void l1i_active_energy();
-void l1d_active_energy();
-void l2_active_energy();
-void dram_active_energy();
-
-
-
-/**************************************
- * Main entry point
-***************************************/
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <trace_file.din> <-n> <-a> <associativity>\n", argv[0]);
-        return 1;
-    }
-
-    if (argc == 2) {
-        print_title();
-    }
-
-    // Initialize caches
-    SET_ASSOCIATIVITY = DEFAULT_ASSOCIATIVITY;
-
-    // set associativity
-    if (argc > 3) {
-        int associativity = atoi(argv[4]);
-        if (associativity % 2 != 0) {
-            fprintf(stderr, "Invalid associativity\n");
-            exit(1);
-        }
-        SET_ASSOCIATIVITY = associativity;
-    }
-
-    simulation_clock = 0.0;
-    init_caches();
-
-    // print args
-    printf("File: %s\n\n", argv[1]);
-
-    // simulation
-    process_dinero_trace(argv[1]);
-
-    // stats
-    print_stats();
-
-    printf("==========================\n");
-
-    return 0;
-}
-
-
-/**
- * Print a lil title
-*/
-void print_title() {
-    printf("_________               .__               _________.__              .__          __                \n");
-    printf("\\_   ___ \\_____    ____ |  |__   ____    /   _____/|__| _____  __ __|  | _____ _/  |_  ___________ \n");
-    printf("/    \\  \\/\\__  \\ _/ ___\\|  |  \\_/ __ \\   \\_____  \\ |  |/     \\|  |  \\  | \\__  \\   __\\/  _  \\_  __ \n");
-    printf("\\     \\____/ __ \\\\  \\___|   Y  \\  ___/   /        \\|  |  Y Y  \\  |  /  |__/ __ \\|  | (  <_> )  | \\/\n");
-    printf(" \\______  (____  /\\___  >___|  /\\___  > /_______  /|__|__|_|  /____/|____(____  /__|  \\____/|__|  \n");
-    printf("        \\/     \\/     \\/     \\/     \\/          \\/          \\/                \\/                   \n");
-    printf("_________   _________ _________________  ______ \n");
-    printf("\\_   ___ \\ /   _____/ \\_____  \\______  \\/  __  \\ \n");
-    printf("/    \\  \\/ \\_____  \\    _(__  <   /    />      < \n");
-    printf("\\     \\____/        \\  /       \\ /    //   --   \\\n");
-    printf(" \\______  /_______  / /______  //____/ \\______  / \n");
-    printf("        \\/        \\/         \\/               \\/  \n\n");
-}
-
-
-/**
- * Print Stats
-*/
-void print_stats() {
-    printf("\nStatistics: \n");
-
-    printf("Set Associativity: %lu\n\n", SET_ASSOCIATIVITY);
-
-    // total access time and energy
-    printf("Total Access Time and Energy:\n");
-    printf("Total Access Time      | Total Dynamic Energy (W) | Total Static Energy (pJ) \n");
-    printf("-----------------------|--------------------------|-------------------------\n");
-    printf("%-15.2f        | %f           | %f\n", simulation_clock, l1i_energy+l1d_energy+l2_energy+dram_energy,
-        l1i_static_energy+l1d_static_energy+l2_static_energy+dram_static_energy);
-   printf("\n");
-
-        // L1 cache statistics
-    printf("L1 Cache Statistics:\n");
-    printf("Component | # Hits      | # Misses    | Dynamic Energy (W) | Static Energy (pJ) \n");
-    printf("----------|-------------|-------------|--------------------|-------------------\n");
-    printf("L1 icache | %-9lu   | %-9lu   | %-9.2f   | %-9.2f\n",
-        l1_icache_hits, l1_icache_misses, l1i_energy, l1i_static_energy);
-    printf("L1 dcache | %-9lu   | %-9lu   | %-9.2f   | %-9.2f\n",
-        l1_dcache_hits, l1_dcache_misses, l1d_energy, l1d_static_energy);
-   printf("\n");
-
-    // L2 cache statistics
-    printf("L2 Cache Statistics:\n");
-    printf("Component | # Hits      | # Misses    | Dynamic Energy (W) | Static Energy (pJ) \n");
-    printf("----------|-------------|-------------|--------------------|-------------------\n");
-    printf("L2        | %-9lu   | %-9lu   | %-9.2f  | %-9.2f\n",
-        l2_hits, l2_misses, l2_energy, l2_static_energy);
-    printf("\n");
-
-    // DRAM stats
-    printf("DRAM Statistics:\n");
-    printf("Component | # Hits      | # Misses    | Dynamic Energy (W) | Static Energy (pJ) \n");
-    printf("----------|-------------|-------------|--------------------|-------------------\n");
-    printf("DRAM      | %-9lu   | N/A         | %-9.2f   | %-9.2f\n",
-        dram_hits, dram_energy, dram_static_energy);
-   printf("\n");
-}
-
-
-/**
- * Process File
-*/
-void process_dinero_trace(const char* filename) {
-    // Process trace file
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Error: Unable to open trace file. Is it in Dinero 3 .din format?\n");
-        exit(1);
-    }
-
-    char operation;
-    int opcode;
-    unsigned long int address, value;
-
-    printf("Running simulation ...\n");
-
-    while (fscanf(file, "%c %lx %lx\n", &operation, &address, &value) == 3) {
-        opcode = operation - '0';
-
-
-        // memory read
-        if (opcode == MEMORY_READ && value == 0) {
-            do_memory_read(address);
-        }
-        // memory write
-        else if (opcode == MEMORY_WRITE && value == 0) {
-            // what do we write to??
-            // just acces DRAM for time?
-            do_memory_write(address, &value);
-        }
-        // instruction fetch
-        else if (opcode == INSTR_FETCH) {
-            do_instruction_fetch(address, &value);
-        }
-        // ignore
-        else if (opcode == IGNORE && address == 0) {
-            void do_ignore();
-        }
-        // flush cache
-        else if (opcode == FLUSH_CACHE && address == 0) {
-            void do_cache_flush();
-        }
-        else {
-            printf("Operation: %c, Address: 0x%lx, Value: 0x%lx\n", operation, address, value);
-            fprintf(stderr, "Error: Invalid operation code or arguments.\n");
-            exit(1);
-        }
-    }
-    fclose(file);
-    printf("Simulation Complete.\n\n");
-}
-
-
-/**
- * Initialize all caches
-*/
-void init_caches() {
-    // L1 icache
-    for (size_t i = 0; i < L1_INSTRUCTION_NUM_BLOCKS; i++) {
-        l1_instruction_cache[i].valid = 0;
-        l1_instruction_cache[i].dirty = 0;
-        l1_instruction_cache[i].tag = -1;
-        for (size_t j = 0; j < BLOCK_SIZE / sizeof(int); j++) {
-            l1_instruction_cache[i].data[j] = 0;
-        }
-    }
-
-    // L1 dcache
-    for (size_t i = 0; i < L1_DATA_NUM_BLOCKS; i++) {
-        l1_data_cache[i].valid = 0;
-        l1_data_cache[i].dirty = 0;
-        l1_data_cache[i].tag = -1;
-        for (size_t j = 0; j < BLOCK_SIZE / sizeof(int); j++) {
-            l1_data_cache[i].data[j] = 0;
-        }
-    }
-
-    // L2 cache
-    for (size_t i = 0; i < NUM_SETS; i++) {
-        for (size_t j = 0; j < SET_ASSOCIATIVITY; j++) {
-            l2_cache[i][j].valid = 0;
-            l2_cache[i][j].dirty = 0;
-            l2_cache[i][j].tag = -1;
-            for (size_t k = 0; k < BLOCK_SIZE / sizeof(int); k++) {
-                l2_cache[i][j].data[k] = 0;
-            }
-        }
-    }
-}
-
-
-/** +++++++++++++++++++++++++++++++++++++++++++
- * Operation wrapper functions
-*/
-
-
-/**
- * Do a memory read.
-*/
-void do_memory_read(unsigned long int address) {
-    read_l1_dcache(address);
-}
-
-
-/**
- * Do a memory write.
-*/
-void do_memory_write(unsigned long int address, unsigned long int* data) {
-    write_l1_dcache(address, data);
-}
-
-
-/**
- * Do an instruction fetch.
-*/
-void do_instruction_fetch(unsigned long int address, unsigned long int value) {
-    read_l1_icache(address);
-}
-
-
-/**
- * Do an ignore.
-*/
-void do_ignore() {
-    // idle energy consumption
-    l1i_idle_energy();
-    l1d_idle_energy();
-    l2_idle_energy();
-    dram_idle_energy();
-
-    simulation_clock += ONE_CYCLE;
-}
-
-
-/**
- * Do a cache flush.
- * This won't actually be tested in the trace test cases.
- * But just in case.
-*/
-void do_cache_flush() {
-    init_caches();
-    do_ignore(); 
-}
-
-
-/** ++++++++++++++++++++++++
- * Internal cache operations
-   +++++++++++++++++++++++++  */
-
-
-/**
- * Read L1 Instruction Cache
-*/
-unsigned long int* read_l1_icache(unsigned long int address) {
-    l1i_active_energy();
-    l1d_idle_energy();
-    l2_idle_energy();
-    dram_idle_energy();
-
-    // Calculate cache index and tag from the address
-    size_t index = (address / BLOCK_SIZE) % L1_INSTRUCTION_NUM_BLOCKS;
-    int tag = address / (BLOCK_SIZE * L1_INSTRUCTION_NUM_BLOCKS);
-
-    // Cache hit
-    if (l1_instruction_cache[index].valid && l1_instruction_cache[index].tag == tag) {
-        l1_icache_hits++;
-        simulation_clock += L1_ACCESS_TIME;
-        return l1_instruction_cache[index].data;
-    }
-
-    // cache miss
-    l1_icache_misses++;
-    l2_static_energy += 5;
-    simulation_clock += L1_ACCESS_TIME;
-
-    // Cache miss, access L2 cache to fetch data
-    unsigned long int* data = read_l2_cache(address);
-
-    // Update L1 instruction cache with fetched data
-    l1_instruction_cache[index].valid = 1;
-    l1_instruction_cache[index].tag = tag;
-    memcpy(l1_instruction_cache[index].data, data, BLOCK_SIZE);
-
-    return data;
-}
-
-
-/**
- * Read L1 Data Cache
-*/
-unsigned long int* read_l1_dcache(unsigned long int address) {
-    l1d_active_energy();
-    l1i_idle_energy();
-    l2_idle_energy();
-    dram_idle_energy();
-
-    simulation_clock += L1_ACCESS_TIME;
-
-    size_t index = (address / BLOCK_SIZE) % L1_DATA_NUM_BLOCKS;
-    int tag = address / (BLOCK_SIZE * L1_DATA_NUM_BLOCKS);
-
-    if (l1_data_cache[index].valid && l1_data_cache[index].tag == tag) {
-        // Cache hit
-        l1_dcache_hits++;
-        return l1_data_cache[index].data;
-    }
-
-    // Cache miss
-    l1_dcache_misses++;
-
-    // seg fault
-    long unsigned int* data = read_l2_cache(address);
-
-    // Update L1 data cache with fetched data
-    l1_data_cache[index].valid = 1;
-    l1_data_cache[index].tag = tag;
-    l1_data_cache[index].dirty = 0;
-
-    memcpy(l1_data_cache[index].data, data, BLOCK_SIZE);
-
-    // Return pointer to the data
-    return l1_data_cache[index].data;
-}
-
-
-/**
- * Read L2 Cache
-*/
-unsigned long int* read_l2_cache(unsigned long int address) {
-    l2_active_energy();
-    l1i_idle_energy();
-    l1d_idle_energy();
-    dram_idle_energy();
-
-    simulation_clock += L2_ACCESS_TIME;
-   
-    // Calculate set index and tag from the address
-    size_t setIndex = (address / BLOCK_SIZE) % NUM_SETS;
-    int tag = address / (BLOCK_SIZE * NUM_SETS);
-
-    // find block in the set
-    for (size_t i = 0; i < SET_ASSOCIATIVITY; i++) {
-        if (l2_cache[setIndex][i].valid && l2_cache[setIndex][i].tag == tag) {
-            // Cache hit
-            l2_hits++;
-
-            return l2_cache[setIndex][i].data;
-        }
-    }
-
-    // cache miss
-    l2_misses++;
-    dram_static_energy += 640;
-
-    // Simulate data fetching from memory
-    unsigned long int* data = read_dram(address);
-
-    // Random replacement policy
-    int replacementIndex = rand() % SET_ASSOCIATIVITY;
-
-
-    // Update block with fetched data
-    l2_cache[setIndex][replacementIndex].valid = 1;
-    l2_cache[setIndex][replacementIndex].tag = tag;
-    memcpy(l2_cache[setIndex][replacementIndex].data, data, BLOCK_SIZE);
-
-    return data;
-}
-
-
-/**
- * Access DRAM
- * Simulate only time and energy
-*/
-unsigned long int* read_dram(unsigned long int address) {
-    dram_active_energy();
-    l1i_idle_energy();
-    l1d_idle_energy();
-    l2_idle_energy();
-
-    int* dummy_data = (int*) malloc(BLOCK_SIZE);
-    if (!dummy_data) {
-        fprintf(stderr, "Malloc failed\n");
-        exit(1);
-    }
-
-    srand(time(NULL));
-    for (size_t i = 0; i < BLOCK_SIZE / sizeof(int); i++) {
-        dummy_data[i] = rand();
-    }
-
-    dram_hits++;
-    simulation_clock += DRAM_ACCESS_TIME; // incurred time should be 50ns
-
-    return dummy_data;
-}
-
-
-/**
- * Write L1 Instruction Cache
-*/
-void write_l1_icache(unsigned long int address, unsigned long int* data) {
-    l1i_active_energy();
-    l1d_idle_energy();
-    l2_idle_energy();
-    dram_idle_energy();
-
-    // ed discussion project clarification:
-    // writes are 5ns because only writes to l1,l2 are synchronous
-    simulation_clock += WRITE_TIME;
-
-    // Calculate cache index and tag from the address
-    size_t index = (address / BLOCK_SIZE) % L1_INSTRUCTION_NUM_BLOCKS;
-    int tag = address / (BLOCK_SIZE * L1_INSTRUCTION_NUM_BLOCKS);
-
-    l1_data_cache[index].valid = 1;
-    l1_data_cache[index].tag = tag;
-    l1_data_cache[index].dirty = 1;
-
-    memcpy(l1_instruction_cache[index].data, data, BLOCK_SIZE);
-}
-
-
-/**
- * Write to the L1 data cache
-*/
-void write_l1_dcache(unsigned long int address, unsigned long int* data) {
-    l1d_active_energy();
-    l1i_idle_energy();
-    l2_idle_energy();
-    dram_idle_energy();
-  
-    // writes are 5ns because only writes to l1,l2 are synchronous
-    simulation_clock += L1_ACCESS_TIME;
-
-    // Calculate cache index and tag from the address
-    size_t index = (address / BLOCK_SIZE) % L1_DATA_NUM_BLOCKS;
-    int tag = address / (BLOCK_SIZE * L1_DATA_NUM_BLOCKS);
-
-    // Check if the cache line is present
-    if (l1_data_cache[index].valid && l1_data_cache[index].tag == tag) {
-        l1_dcache_hits++;
-
-        // Check if the cache line is dirty
-        if (l1_data_cache[index].dirty) {
-            // Write back the modified data to L2 cache or DRAM
-            write_l2_cache(l1_data_cache[index].tag, l1_data_cache[index].data);
-        }
-    } else {
-        l1_dcache_misses++;
-        simulation_clock += L2_ACCESS_TIME; // l1 miss, l2 miss: 5ns 
-    }
-
-    l1_data_cache[index].valid = 1;
-    l1_data_cache[index].tag = tag;
-    l1_data_cache[index].dirty = 1;
-
-    memcpy(l1_data_cache[index].data, data, BLOCK_SIZE);
-}
-
-
-/**
- * Write to the L2 cache
-*/
-void write_l2_cache(unsigned long int address, unsigned long int* data) {
-    l2_active_energy();
-    l1i_idle_energy();
-    l1d_idle_energy();
-    dram_idle_energy();
-
-    simulation_clock += L2_ACCESS_TIME; // incurred time should be 5ns
-
-    size_t setIndex = (address / BLOCK_SIZE) % NUM_SETS;
-    int tag = address / (BLOCK_SIZE * NUM_SETS);
-
-    // Check if block is already present
-    for (size_t i = 0; i < SET_ASSOCIATIVITY; i++) {
-        if (l2_cache[setIndex][i].valid && l2_cache[setIndex][i].tag == tag) {
-            // cache hit
-            l2_hits++;
-            memcpy(l2_cache[setIndex][i].data, data, BLOCK_SIZE);
-            l2_cache[setIndex][i].dirty = 1;
-
-            // hit, dont write back
-            l2_hits++;
-            return;
-        }
-    }
-
-    // cache miss
-    l2_misses++;
-    int replacementIndex = rand() % SET_ASSOCIATIVITY;
-
-    if (l2_cache[setIndex][replacementIndex].dirty) {
-        // if evicting block, "write" it back to DRAM
-        write_dram(address, l2_cache[setIndex][replacementIndex].data);
-    }
-
-    // Update the cache block
-    l2_cache[setIndex][replacementIndex].valid = 1;
-    l2_cache[setIndex][replacementIndex].tag = tag;
-    l2_cache[setIndex][replacementIndex].dirty = 1;
-    memcpy(l2_cache[setIndex][replacementIndex].data, data, BLOCK_SIZE);
-}
-
-
-/**
- * "Write" to DRAM
-*/
-void write_dram(unsigned long int address, unsigned long int* data) {  
-    dram_active_energy();
-    l1i_idle_energy();
-    l1d_idle_energy();
-    l2_idle_energy();
-
-    // using a dummy write
-    memcpy(dram + address, data, BLOCK_SIZE);
-
-    dram_hits++; 
-    // no time incurred for dram write
-}
-
-/**
- * Simulate idle L1 icache
-*/
-void l1i_idle_energy() {
-    l1i_energy += L1_IDLE_ENERGY;
-}
-
-/**
- * Simulate idle L1 dcache
-*/
-void l1d_idle_energy() {
-    l1d_energy += L1_IDLE_ENERGY;
-}
-
-
-/**
- * Simulate idle L2 cache
-*/
-void l2_idle_energy() {
-    l2_energy += L2_IDLE_ENERGY;
-}
-
-
-/**
- * Simulate idle DRAM
-*/
-void dram_idle_energy() {
-    dram_energy += DRAM_IDLE_ENERGY;
-}
-
-
-/**
- * Simulate energy consumption of L1 icache
-*/
-void l1i_active_energy() {
-    l1i_energy += L1_RW_ENERGY;
-}
-
-/**
- * Simulate energy consumption of L1 dcache
-*/
-void l1d_active_energy() {
-    l1d_energy += L1_RW_ENERGY;
-}
-
-
-/**
- * Simulate energy consumption of L2 cache
-*/
-void l2_active_energy() {
-    l2_energy += L2_RW_ENERGY;
-}
-
-
-/**
- * Simulate energy consumption of DRAM
-*/
-void dram_active_energy() {
-    dram_energy += DRAM_RW_ENERGY;
-}
-
-
-/**
- * Proccess input trace file in Din 3 format
-*/
-void process_trace_file(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Error: Unable to open trace file\n");
-        exit(1);
-    }
-
-    char operation;
-    unsigned long int address;
-
-
-    while (fscanf(file, "%c %lx\n", &operation, &address) == 2) {
-        // ex
-        printf("Operation: %c, Address: 0x%lx\n", operation, address);
-    }
-
-    fclose(file);
-}
-
+#define _DEFAULT_SOURCE
+
+#include <sys/mman.h>
+
+#include "./cache_simulator.h"
+#include "./profile.h"
+#include "./trace.h"
+
+
+// cache state
+void init_caches(CacheSim* sim);
+
+// simulated accesses
+unsigned long int* read_l1_icache(CacheSim* sim, unsigned long int address);
+unsigned long int* read_l1_dcache(CacheSim* sim, unsigned long int address);
+unsigned long int* read_l2_cache(CacheSim* sim, unsigned long int address);
+unsigned long int* read_l3_cache(CacheSim* sim, unsigned long int address);
+unsigned long int* read_dram(CacheSim* sim, unsigned long int address);
+
+// simulated writes
+void write_l1_icache(CacheSim* sim, unsigned long int address, unsigned long int* data);
+void write_l1_dcache(CacheSim* sim, unsigned long int address, unsigned long int* data);
+void write_l2_cache(CacheSim* sim, unsigned long int address, unsigned long int* data);
+void write_l3_cache(CacheSim* sim, unsigned long int address, unsigned long int* data);
+void write_dram(CacheSim* sim, unsigned long int address, unsigned long int* data);
+
+// op codes
+void do_memory_read(CacheSim* sim, unsigned long int address);
+void do_memory_write(CacheSim* sim, unsigned long int address, unsigned long int* data);
+void do_instruction_fetch(CacheSim* sim, unsigned long int address, unsigned long int value);
+void do_ignore(CacheSim* sim);
+void do_cache_flush(CacheSim* sim);
+
+// energy sim, counted here and priced by an EnergyModel when printed
+static void charge_access(CacheSim* sim, int part);
+static void charge_idle(CacheSim* sim);
+
+// non-blocking timing model
+typedef struct {
+    double clock;
+    unsigned long int l1_misses;
+    unsigned long int l2_misses;
+    unsigned long int l3_misses;
+} TimingMark;
+static void timing_begin(const CacheSim* sim, TimingMark* mark);
+static void timing_end(CacheSim* sim, const TimingMark* mark, int opcode, unsigned long int address);
+static void reset_timing(CacheSim* sim);
+
+// prefetchers
+static int prefetch_use(CacheSim* sim, CacheLevel* cache, PrefetchStats* stats, size_t entry);
+static void prefetch_evict(CacheLevel* cache, PrefetchStats* stats, size_t entry);
+static int prefetch_stream_hit(CacheSim* sim, Prefetcher* prefetcher, CacheLevel* cache, PrefetchStats* stats,
+                               unsigned long int address);
+static void prefetch_train(CacheSim* sim, Prefetcher* prefetcher, CacheLevel* cache, PrefetchStats* stats,
+                           unsigned long int address, int trigger);
+
+
+
+/**
+ * Create a simulator with cold caches
+*/
+CacheSim* create_simulator(const CacheConfig* config) {
+    CacheSim* sim = calloc(1, sizeof(CacheSim));
+    if (!sim) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    sim->config = *config;
+
+    int with_data = !config->tags_only;
+    unsigned long int block_size = config->block_size;
+    init_level(&sim->l1_instruction_cache, level_num_sets(config, &config->l1i), config->l1i.associativity,
+        block_size, with_data, config->l1i.policy);
+    init_level(&sim->l1_data_cache, level_num_sets(config, &config->l1d), config->l1d.associativity,
+        block_size, with_data, config->l1d.policy);
+    init_level(&sim->l2_cache, level_num_sets(config, &config->l2), config->l2.associativity,
+        block_size, with_data, config->l2.policy);
+
+    sim->has_l3 = config->l3.size != 0;
+    if (sim->has_l3) {
+        init_level(&sim->l3_cache, level_num_sets(config, &config->l3), config->l3.associativity,
+            block_size, with_data, config->l3.policy);
+    }
+
+    // wide levels look tags up through an index
+    if (level_indexed(config, &config->l1i)) {
+        level_enable_index(&sim->l1_instruction_cache);
+    }
+    if (level_indexed(config, &config->l1d)) {
+        level_enable_index(&sim->l1_data_cache);
+    }
+    if (level_indexed(config, &config->l2)) {
+        level_enable_index(&sim->l2_cache);
+    }
+    if (sim->has_l3 && level_indexed(config, &config->l3)) {
+        level_enable_index(&sim->l3_cache);
+    }
+
+    // next-line and stride fill the level, stream buffers sit beside it
+    prefetch_reset(&sim->l1d_prefetcher, config->l1d.prefetch, config->prefetch_degree);
+    prefetch_reset(&sim->l2_prefetcher, config->l2.prefetch, config->prefetch_degree);
+    if (config->l1d.prefetch != PREFETCH_NONE) {
+        level_enable_prefetch(&sim->l1_data_cache);
+    }
+    if (config->l2.prefetch != PREFETCH_NONE) {
+        level_enable_prefetch(&sim->l2_cache);
+    }
+    reset_timing(sim);
+
+    if (config->classify) {
+        const LevelConfig* levels[NUM_CLASSIFIED] = { &config->l1i, &config->l1d, &config->l2, &config->l3 };
+        sim->shadows = calloc(NUM_CLASSIFIED, sizeof(ShadowCache));
+        if (!sim->shadows) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        for (int i = 0; i < NUM_CLASSIFIED; i++) {
+            shadow_init(&sim->shadows[i], levels[i]->size / block_size);
+        }
+    }
+
+    if (with_data) {
+        sim->dram_block = calloc(1, block_size);
+        sim->write_block = calloc(1, block_size);
+        if (!sim->dram_block || !sim->write_block) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+    }
+
+    // dummy DRAM data from a fixed seed, so images and checkpoints repeat
+    sim->data_seed = 1;
+
+    sim->stats.simulation_clock = 0.0;
+
+    return sim;
+}
+
+
+/**
+ * Free a simulator
+*/
+void destroy_simulator(CacheSim* sim) {
+    if (sim->dram) {
+        munmap(sim->dram, DRAM_SIZE);
+    }
+    free_level(&sim->l1_instruction_cache);
+    free_level(&sim->l1_data_cache);
+    free_level(&sim->l2_cache);
+    if (sim->has_l3) {
+        free_level(&sim->l3_cache);
+    }
+    if (sim->shadows) {
+        for (int i = 0; i < NUM_CLASSIFIED; i++) {
+            shadow_free(&sim->shadows[i]);
+        }
+        free(sim->shadows);
+    }
+    free(sim->dram_block);
+    free(sim->write_block);
+    free(sim);
+}
+
+
+/**
+ * Run a trace through every simulator without printing anything.
+ * Safe to call from several threads on different simulators.
+*/
+RunResult run_dinero_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims) {
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+
+    TraceReader reader;
+    if (trace_open(&reader, filename, reader_kind) != 0) {
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+
+    TraceRecord* batch = malloc(SWEEP_BATCH_SIZE * sizeof(TraceRecord));
+    if (!batch) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    int status = TRACE_RECORD;
+
+    while (status == TRACE_RECORD && result.status == RUN_OK) {
+        size_t count = 0;
+        while (count < SWEEP_BATCH_SIZE && (status = trace_next(&reader, &batch[count])) == TRACE_RECORD) {
+            count++;
+        }
+
+        for (size_t i = 0; i < num_sims && result.status == RUN_OK; i++) {
+            size_t done = simulate_records(sims[i], batch, count);
+            if (done < count) {
+                result.status = RUN_INVALID_OP;
+                result.record = batch[done];
+            }
+        }
+        result.records += count;
+    }
+
+    if (result.status == RUN_OK && status == TRACE_MALFORMED) {
+        result.status = RUN_MALFORMED;
+        result.line = reader.line;
+    }
+
+    free(batch);
+    trace_close(&reader);
+    return result;
+}
+
+
+/**
+ * Run one trace record through a simulator.
+ * Returns -1 for an invalid operation code or arguments.
+*/
+int simulate_record(CacheSim* sim, const TraceRecord* record) {
+    char operation = record->operation;
+    unsigned long int address = record->address;
+    unsigned long int value = record->value;
+    int opcode = operation - '0';
+    TimingMark mark;
+    timing_begin(sim, &mark);
+
+
+    // memory read
+    if (opcode == MEMORY_READ && value == 0) {
+        do_memory_read(sim, address);
+    }
+    // memory write
+    else if (opcode == MEMORY_WRITE && value == 0) {
+        // what do we write to??
+        // just acces DRAM for time?
+        do_memory_write(sim, address, &value);
+    }
+    // instruction fetch
+    else if (opcode == INSTR_FETCH) {
+        do_instruction_fetch(sim, address, value);
+    }
+    // ignore
+    else if (opcode == IGNORE && address == 0) {
+        void do_ignore();
+    }
+    // flush cache
+    else if (opcode == FLUSH_CACHE && address == 0) {
+        void do_cache_flush();
+    }
+    else {
+        return -1;
+    }
+    timing_end(sim, &mark, opcode, address);
+    return 0;
+}
+
+
+/**
+ * Count n more hits on a block an L1 holds and just looked up, as if each
+ * had run through read_l1_icache or read_l1_dcache. Touching the block again
+ * changes no replacement state after the first touch, and the L1's shadow
+ * (with classify) already has it most recent.
+*/
+static void repeat_hits(CacheSim* sim, int opcode, unsigned long int address, unsigned long int n) {
+    PROFILE_SCOPE(opcode == INSTR_FETCH ? PROFILE_L1I : PROFILE_L1D);
+    // every coalesced hit is one call of its L1
+    PROFILE_COUNT(opcode == INSTR_FETCH ? PROFILE_L1I : PROFILE_L1D, n - 1);
+    int icache = opcode == INSTR_FETCH;
+    CacheLevel* cache = icache ? &sim->l1_instruction_cache : &sim->l1_data_cache;
+    size_t set = level_set_index(cache, address);
+    long way = level_lookup(cache, set, level_tag(cache, address));
+    policy_touch(cache, set, way);
+
+    sim->stats.energy.ticks += n;
+    sim->stats.energy.active[icache ? PART_L1I : PART_L1D] += n;
+    if (icache) {
+        sim->stats.l1_icache_hits += n;
+    } else {
+        sim->stats.l1_dcache_hits += n;
+    }
+    sim->stats.simulation_clock += n * L1_ACCESS_TIME;
+}
+
+
+/**
+ * Run records through a simulator like simulate_record, coalescing runs of
+ * references to one block. A fetch of the block the previous fetch used, or
+ * a read of the block the previous read or write used, is sure to hit its
+ * L1, so consecutive ones are only counted and applied at once before the
+ * next access that runs through the hierarchy. Reads aren't coalesced with
+ * an L1 dcache prefetcher, which trains on hits, and nothing is with the
+ * non-blocking timing model, which times every access.
+ * Returns the records simulated, short of count at the first invalid one.
+*/
+size_t simulate_records(CacheSim* sim, const TraceRecord* records, size_t count) {
+    if (sim->config.issue_window) {
+        for (size_t i = 0; i < count; i++) {
+            if (simulate_record(sim, &records[i]) != 0) {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    int coalesce_reads = sim->config.l1d.prefetch == PREFETCH_NONE;
+    unsigned int shift = sim->l1_data_cache.block_shift;
+
+    // last block of each stream and the hits on it not applied yet
+    unsigned long int fetch_block = 0, data_block = 0;
+    int have_fetch = 0, have_data = 0;
+    unsigned long int fetch_repeats = 0, data_repeats = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const TraceRecord* record = &records[i];
+        int opcode = record->operation - '0';
+        unsigned long int block = record->address >> shift;
+
+        if (opcode == INSTR_FETCH && have_fetch && block == fetch_block) {
+            fetch_repeats++;
+            continue;
+        }
+        if (opcode == MEMORY_READ && record->value == 0 && coalesce_reads && have_data && block == data_block) {
+            data_repeats++;
+            continue;
+        }
+
+        if (fetch_repeats) {
+            repeat_hits(sim, INSTR_FETCH, fetch_block << shift, fetch_repeats);
+            fetch_repeats = 0;
+        }
+        if (data_repeats) {
+            repeat_hits(sim, MEMORY_READ, data_block << shift, data_repeats);
+            data_repeats = 0;
+        }
+        if (simulate_record(sim, record) != 0) {
+            return i;
+        }
+
+        if (opcode == INSTR_FETCH) {
+            fetch_block = block;
+            have_fetch = 1;
+        } else if (opcode == MEMORY_READ || opcode == MEMORY_WRITE) {
+            data_block = block;
+            have_data = 1;
+        } else if (opcode == FLUSH_CACHE) {
+            have_fetch = have_data = 0;
+        }
+    }
+
+    if (fetch_repeats) {
+        repeat_hits(sim, INSTR_FETCH, fetch_block << shift, fetch_repeats);
+    }
+    if (data_repeats) {
+        repeat_hits(sim, MEMORY_READ, data_block << shift, data_repeats);
+    }
+    return count;
+}
+
+
+/**
+ * Run one captured L1 miss or write back into the L2.
+ * Returns -1 for an opcode a capture never holds.
+*/
+int replay_l1_miss(CacheSim* sim, const TraceRecord* record) {
+    switch (record->operation - '0') {
+    case MEMORY_READ:
+    case INSTR_FETCH:
+        read_l2_cache(sim, record->address);
+        return 0;
+    case MEMORY_WRITE:
+        write_l2_cache(sim, record->address, NULL);
+        return 0;
+    }
+    return -1;
+}
+
+
+/**
+ * Whether simulate_record would accept a record
+*/
+int record_valid(const TraceRecord* record) {
+    int opcode = record->operation - '0';
+    return ((opcode == MEMORY_READ || opcode == MEMORY_WRITE) && record->value == 0)
+        || opcode == INSTR_FETCH
+        || ((opcode == IGNORE || opcode == FLUSH_CACHE) && record->address == 0);
+}
+
+
+/**
+ * Add the counters of one run into another
+*/
+void add_stats(CacheStats* total, const CacheStats* stats) {
+    total->l1_icache_misses += stats->l1_icache_misses;
+    total->l1_dcache_misses += stats->l1_dcache_misses;
+    total->l2_misses += stats->l2_misses;
+    total->l3_misses += stats->l3_misses;
+
+    total->l1_icache_hits += stats->l1_icache_hits;
+    total->l1_dcache_hits += stats->l1_dcache_hits;
+    total->l2_hits += stats->l2_hits;
+    total->l3_hits += stats->l3_hits;
+    total->dram_hits += stats->dram_hits;
+    add_prefetch_stats(&total->l1d_prefetch, &stats->l1d_prefetch);
+    add_prefetch_stats(&total->l2_prefetch, &stats->l2_prefetch);
+
+    total->energy.ticks += stats->energy.ticks;
+    for (int part = 0; part < NUM_PARTS; part++) {
+        total->energy.active[part] += stats->energy.active[part];
+        total->energy.fills[part] += stats->energy.fills[part];
+    }
+
+    total->simulation_clock += stats->simulation_clock;
+    add_timing_stats(&total->timing, &stats->timing);
+    for (int i = 0; i < NUM_CLASSIFIED; i++) {
+        add_miss_classes(&total->classes[i], &stats->classes[i]);
+    }
+}
+
+
+/**
+ * Prefetch the sets an access will look at in its L1 and the L2
+*/
+static void prefetch_access(const CacheSim* sim, unsigned long int address, uint8_t op) {
+    level_prefetch(op == INSTR_FETCH ? &sim->l1_instruction_cache : &sim->l1_data_cache, address);
+    level_prefetch(&sim->l2_cache, address);
+}
+
+
+/**
+ * Run accesses handed over in memory instead of read from a trace.
+ * ops are MEMORY_READ, MEMORY_WRITE (of a zero word) or INSTR_FETCH.
+ * Returns the accesses simulated, short of n at the first invalid op.
+*/
+size_t cache_access_batch(CacheSim* sim, const uint64_t* addrs, const uint8_t* ops, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (i + BATCH_PREFETCH_DISTANCE < n) {
+            prefetch_access(sim, addrs[i + BATCH_PREFETCH_DISTANCE], ops[i + BATCH_PREFETCH_DISTANCE]);
+        }
+
+        unsigned long int address = addrs[i];
+        unsigned long int value = 0;
+        TimingMark mark;
+        timing_begin(sim, &mark);
+        switch (ops[i]) {
+        case MEMORY_READ:
+            do_memory_read(sim, address);
+            break;
+        case MEMORY_WRITE:
+            do_memory_write(sim, address, &value);
+            break;
+        case INSTR_FETCH:
+            do_instruction_fetch(sim, address, value);
+            break;
+        default:
+            return i;
+        }
+        timing_end(sim, &mark, ops[i], address);
+    }
+    return n;
+}
+
+
+/**
+ * Initialize all caches
+*/
+void init_caches(CacheSim* sim) {
+    reset_level(&sim->l1_instruction_cache);
+    reset_level(&sim->l1_data_cache);
+    reset_level(&sim->l2_cache);
+    if (sim->has_l3) {
+        reset_level(&sim->l3_cache);
+    }
+    prefetch_reset(&sim->l1d_prefetcher, sim->config.l1d.prefetch, sim->config.prefetch_degree);
+    prefetch_reset(&sim->l2_prefetcher, sim->config.l2.prefetch, sim->config.prefetch_degree);
+    reset_timing(sim);
+    if (sim->shadows) {
+        for (int i = 0; i < NUM_CLASSIFIED; i++) {
+            shadow_reset(&sim->shadows[i]);
+        }
+    }
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Operation wrapper functions
+*/
+
+
+/**
+ * Do a memory read.
+*/
+void do_memory_read(CacheSim* sim, unsigned long int address) {
+    read_l1_dcache(sim, address);
+}
+
+
+/**
+ * Do a memory write.
+*/
+void do_memory_write(CacheSim* sim, unsigned long int address, unsigned long int* data) {
+    // the trace gives one word, the rest of the written block is zero
+    if (sim->write_block) {
+        sim->write_block[0] = *data;
+        data = sim->write_block;
+    }
+    write_l1_dcache(sim, address, data);
+}
+
+
+/**
+ * Do an instruction fetch.
+*/
+void do_instruction_fetch(CacheSim* sim, unsigned long int address, unsigned long int value) {
+    read_l1_icache(sim, address);
+}
+
+
+/**
+ * Do an ignore.
+*/
+void do_ignore(CacheSim* sim) {
+    // idle energy consumption
+    charge_idle(sim);
+
+    sim->stats.simulation_clock += ONE_CYCLE;
+}
+
+
+/**
+ * Do a cache flush.
+ * This won't actually be tested in the trace test cases.
+ * But just in case.
+*/
+void do_cache_flush(CacheSim* sim) {
+    init_caches(sim);
+    do_ignore(sim);
+}
+
+
+/** ++++++++++++++++++++++++
+ * Internal cache operations
+   +++++++++++++++++++++++++  */
+
+
+/**
+ * Copy a block into a way, skipped in tags only mode
+*/
+static void fill_data(CacheLevel* cache, size_t entry, const unsigned long int* data) {
+    unsigned long int* block = level_data(cache, entry);
+    if (block && data) {
+        memcpy(block, data, cache->block_size);
+    }
+}
+
+
+/**
+ * Run an access of a level through its shadow, with classify
+*/
+static void classify_access(CacheSim* sim, int level, unsigned long int address, int hit) {
+    if (sim->shadows) {
+        shadow_access(&sim->shadows[level], address / sim->config.block_size, &sim->stats.classes[level], hit);
+    }
+}
+
+
+/**
+ * Append what an L1 sends the L2 to the capture
+*/
+static void capture_l1_miss(CacheSim* sim, int opcode, unsigned long int address) {
+    TraceRecord record = { '0' + opcode, address, 0 };
+    if (trace_write(sim->l1_misses, &record) != 0) {
+        fprintf(stderr, "Error: Unable to write the L1 miss stream\n");
+        exit(1);
+    }
+}
+
+
+/**
+ * Read the L2 for an L1 miss, or capture it: instruction misses as
+ * INSTR_FETCH, data misses as MEMORY_READ
+*/
+static unsigned long int* l1_read_l2(CacheSim* sim, int opcode, unsigned long int address) {
+    if (sim->l1_misses) {
+        capture_l1_miss(sim, opcode, address);
+        return NULL;
+    }
+    return read_l2_cache(sim, address);
+}
+
+
+/**
+ * Write an L1 dcache block back to the L2, or capture it as MEMORY_WRITE
+*/
+static void l1_write_l2(CacheSim* sim, unsigned long int address, unsigned long int* data) {
+    if (sim->l1_misses) {
+        capture_l1_miss(sim, MEMORY_WRITE, address);
+        return;
+    }
+    write_l2_cache(sim, address, data);
+}
+
+
+/**
+ * Read L1 Instruction Cache
+*/
+unsigned long int* read_l1_icache(CacheSim* sim, unsigned long int address) {
+    PROFILE_SCOPE(PROFILE_L1I);
+    charge_access(sim, PART_L1I);
+
+    // Calculate set index and tag from the address
+    CacheLevel* cache = &sim->l1_instruction_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t base = level_entry(cache, setIndex, 0);
+
+    // Cache hit
+    long way = level_lookup(cache, setIndex, tag);
+    classify_access(sim, CLASS_L1I, address, way >= 0);
+    if (way >= 0) {
+        sim->stats.l1_icache_hits++;
+        sim->stats.simulation_clock += L1_ACCESS_TIME;
+        policy_touch(cache, setIndex, way);
+        return level_data(cache, base + way);
+    }
+
+    // cache miss
+    sim->stats.l1_icache_misses++;
+    sim->stats.energy.fills[PART_L1I]++;
+    sim->stats.simulation_clock += L1_ACCESS_TIME;
+
+    // Cache miss, access L2 cache to fetch data
+    unsigned long int* data = l1_read_l2(sim, INSTR_FETCH, address);
+
+    // Update L1 instruction cache with fetched data
+    size_t victim_way = policy_victim(cache, setIndex);
+    size_t victim = base + victim_way;
+    level_fill(cache, setIndex, victim_way, tag);
+    fill_data(cache, victim, data);
+    policy_insert(cache, setIndex, victim_way);
+
+    return data;
+}
+
+
+/**
+ * Read L1 Data Cache
+*/
+unsigned long int* read_l1_dcache(CacheSim* sim, unsigned long int address) {
+    PROFILE_SCOPE(PROFILE_L1D);
+    charge_access(sim, PART_L1D);
+
+    sim->stats.simulation_clock += L1_ACCESS_TIME;
+
+    CacheLevel* cache = &sim->l1_data_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t base = level_entry(cache, setIndex, 0);
+
+    Prefetcher* prefetcher = &sim->l1d_prefetcher;
+    PrefetchStats* prefetch = &sim->stats.l1d_prefetch;
+
+    long way = level_lookup(cache, setIndex, tag);
+    classify_access(sim, CLASS_L1D, address, way >= 0);
+    if (way >= 0) {
+        // Cache hit
+        sim->stats.l1_dcache_hits++;
+        policy_touch(cache, setIndex, way);
+        if (prefetcher->kind != PREFETCH_NONE) {
+            int first_use = prefetch_use(sim, cache, prefetch, base + way);
+            prefetch_train(sim, prefetcher, cache, prefetch, address, first_use);
+        }
+        return level_data(cache, base + way);
+    }
+
+    // Cache miss
+    sim->stats.l1_dcache_misses++;
+    sim->stats.energy.fills[PART_L1D]++;
+
+    // seg fault
+    long unsigned int* data = NULL;
+    if (!prefetch_stream_hit(sim, prefetcher, cache, prefetch, address)) {
+        data = l1_read_l2(sim, MEMORY_READ, address);
+    }
+
+    // Update L1 data cache with fetched data
+    size_t victim_way = policy_victim(cache, setIndex);
+    size_t victim = base + victim_way;
+    prefetch_evict(cache, prefetch, victim);
+    level_fill(cache, setIndex, victim_way, tag);
+    level_set_bit(cache->dirty, victim, 0);
+
+    fill_data(cache, victim, data);
+    policy_insert(cache, setIndex, victim_way);
+
+    if (prefetcher->kind != PREFETCH_NONE) {
+        prefetch_train(sim, prefetcher, cache, prefetch, address, 1);
+    }
+
+    // Return pointer to the data
+    return level_data(cache, victim);
+}
+
+
+/**
+ * Read L2 Cache
+*/
+unsigned long int* read_l2_cache(CacheSim* sim, unsigned long int address) {
+    PROFILE_SCOPE(PROFILE_L2);
+    charge_access(sim, PART_L2);
+
+    sim->stats.simulation_clock += L2_ACCESS_TIME;
+
+    // Calculate set index and tag from the address
+    CacheLevel* cache = &sim->l2_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t base = level_entry(cache, setIndex, 0);
+
+    // the L1 dcache's prefetches don't train the L2's prefetcher
+    Prefetcher* prefetcher = &sim->l2_prefetcher;
+    PrefetchStats* prefetch = &sim->stats.l2_prefetch;
+    int train = prefetcher->kind != PREFETCH_NONE && !sim->prefetching;
+
+    // find block in the set
+    long way = level_lookup(cache, setIndex, tag);
+    classify_access(sim, CLASS_L2, address, way >= 0);
+    if (way >= 0) {
+        // Cache hit
+        sim->stats.l2_hits++;
+        policy_touch(cache, setIndex, way);
+        if (train) {
+            int first_use = prefetch_use(sim, cache, prefetch, base + way);
+            prefetch_train(sim, prefetcher, cache, prefetch, address, first_use);
+        }
+
+        return level_data(cache, base + way);
+    }
+
+    // cache miss
+    sim->stats.l2_misses++;
+    sim->stats.energy.fills[PART_L2]++;
+
+    // Simulate data fetching from the L3 or memory
+    unsigned long int* data = NULL;
+    if (train && prefetch_stream_hit(sim, prefetcher, cache, prefetch, address)) {
+        // the stream buffer had it
+    } else if (sim->has_l3) {
+        data = read_l3_cache(sim, address);
+    } else {
+        data = read_dram(sim, address);
+    }
+
+    // replacement policy picks the way
+    size_t victim_way = policy_victim(cache, setIndex);
+    size_t victim = base + victim_way;
+    prefetch_evict(cache, prefetch, victim);
+
+
+    // Update block with fetched data
+    level_fill(cache, setIndex, victim_way, tag);
+    fill_data(cache, victim, data);
+    policy_insert(cache, setIndex, victim_way);
+
+    if (train) {
+        prefetch_train(sim, prefetcher, cache, prefetch, address, 1);
+    }
+
+    return data;
+}
+
+
+/**
+ * Read L3 Cache, only called when the hierarchy has one
+*/
+unsigned long int* read_l3_cache(CacheSim* sim, unsigned long int address) {
+    PROFILE_SCOPE(PROFILE_L3);
+    charge_access(sim, PART_L3);
+
+    sim->stats.simulation_clock += L3_ACCESS_TIME;
+
+    CacheLevel* cache = &sim->l3_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t base = level_entry(cache, setIndex, 0);
+
+    long way = level_lookup(cache, setIndex, tag);
+    classify_access(sim, CLASS_L3, address, way >= 0);
+    if (way >= 0) {
+        sim->stats.l3_hits++;
+        policy_touch(cache, setIndex, way);
+        return level_data(cache, base + way);
+    }
+
+    // miss, fetch from memory
+    sim->stats.l3_misses++;
+    sim->stats.energy.fills[PART_L3]++;
+    unsigned long int* data = read_dram(sim, address);
+
+    size_t victim_way = policy_victim(cache, setIndex);
+    size_t victim = base + victim_way;
+    level_fill(cache, setIndex, victim_way, tag);
+    fill_data(cache, victim, data);
+    policy_insert(cache, setIndex, victim_way);
+
+    return data;
+}
+
+
+/**
+ * Access DRAM
+ * Simulate only time and energy
+*/
+unsigned long int* read_dram(CacheSim* sim, unsigned long int address) {
+    PROFILE_SCOPE(PROFILE_DRAM);
+    charge_access(sim, PART_DRAM);
+
+    sim->stats.dram_hits++;
+    sim->stats.energy.fills[PART_DRAM]++;
+    sim->stats.simulation_clock += DRAM_ACCESS_TIME; // incurred time should be 50ns
+
+    // nothing to hand back without payloads
+    if (sim->config.tags_only) {
+        return NULL;
+    }
+
+    int* dummy_data = sim->dram_block;
+
+    for (size_t i = 0; i < sim->config.block_size / sizeof(int); i++) {
+        dummy_data[i] = rand_r(&sim->data_seed);
+    }
+
+    return (unsigned long int*) dummy_data;
+}
+
+
+/**
+ * Write L1 Instruction Cache
+*/
+void write_l1_icache(CacheSim* sim, unsigned long int address, unsigned long int* data) {
+    PROFILE_SCOPE(PROFILE_L1I);
+    charge_access(sim, PART_L1I);
+
+    // ed discussion project clarification:
+    // writes are 5ns because only writes to l1,l2 are synchronous
+    sim->stats.simulation_clock += WRITE_TIME;
+
+    // Calculate cache index and tag from the address
+    CacheLevel* cache = &sim->l1_instruction_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t way = policy_victim(cache, setIndex);
+    size_t index = level_entry(cache, setIndex, way);
+
+    level_fill(cache, setIndex, way, tag);
+    level_set_bit(cache->dirty, index, 1);
+
+    fill_data(cache, index, data);
+}
+
+
+/**
+ * Write to the L1 data cache
+*/
+void write_l1_dcache(CacheSim* sim, unsigned long int address, unsigned long int* data) {
+    PROFILE_SCOPE(PROFILE_L1D);
+    charge_access(sim, PART_L1D);
+
+    // writes are 5ns because only writes to l1,l2 are synchronous
+    sim->stats.simulation_clock += L1_ACCESS_TIME;
+
+    // Calculate set index and tag from the address
+    CacheLevel* cache = &sim->l1_data_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t base = level_entry(cache, setIndex, 0);
+    size_t index;
+
+    // Check if the cache line is present
+    long way = level_lookup(cache, setIndex, tag);
+    classify_access(sim, CLASS_L1D, address, way >= 0);
+    if (way >= 0) {
+        sim->stats.l1_dcache_hits++;
+        index = base + way;
+        policy_touch(cache, setIndex, way);
+        prefetch_use(sim, cache, &sim->stats.l1d_prefetch, index);
+
+        // Check if the cache line is dirty
+        if (level_bit(cache->dirty, index)) {
+            // Write back the modified data to L2 cache or DRAM
+            l1_write_l2(sim, cache->tags[index], level_data(cache, index));
+        }
+    } else {
+        sim->stats.l1_dcache_misses++;
+        sim->stats.simulation_clock += L2_ACCESS_TIME; // l1 miss, l2 miss: 5ns
+
+        size_t victim_way = policy_victim(cache, setIndex);
+        index = base + victim_way;
+        prefetch_evict(cache, &sim->stats.l1d_prefetch, index);
+        policy_insert(cache, setIndex, victim_way);
+    }
+
+    level_fill(cache, setIndex, index - base, tag);
+    level_set_bit(cache->dirty, index, 1);
+
+    fill_data(cache, index, data);
+}
+
+
+/**
+ * Write to the L2 cache
+*/
+void write_l2_cache(CacheSim* sim, unsigned long int address, unsigned long int* data) {
+    PROFILE_SCOPE(PROFILE_L2);
+    charge_access(sim, PART_L2);
+
+    sim->stats.simulation_clock += L2_ACCESS_TIME; // incurred time should be 5ns
+
+    CacheLevel* cache = &sim->l2_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t base = level_entry(cache, setIndex, 0);
+
+    // Check if block is already present
+    long way = level_lookup(cache, setIndex, tag);
+    classify_access(sim, CLASS_L2, address, way >= 0);
+    if (way >= 0) {
+        // cache hit
+        sim->stats.l2_hits++;
+        fill_data(cache, base + way, data);
+        level_set_bit(cache->dirty, base + way, 1);
+        policy_touch(cache, setIndex, way);
+        prefetch_use(sim, cache, &sim->stats.l2_prefetch, base + way);
+
+        // hit, dont write back
+        sim->stats.l2_hits++;
+        return;
+    }
+
+    // cache miss
+    sim->stats.l2_misses++;
+    size_t victim_way = policy_victim(cache, setIndex);
+    size_t victim = base + victim_way;
+    prefetch_evict(cache, &sim->stats.l2_prefetch, victim);
+
+    if (level_bit(cache->dirty, victim)) {
+        // if evicting block, "write" it back to the L3 or DRAM
+        if (sim->has_l3) {
+            write_l3_cache(sim, address, level_data(cache, victim));
+        } else {
+            write_dram(sim, address, level_data(cache, victim));
+        }
+    }
+
+    // Update the cache block
+    level_fill(cache, setIndex, victim_way, tag);
+    level_set_bit(cache->dirty, victim, 1);
+    fill_data(cache, victim, data);
+    policy_insert(cache, setIndex, victim_way);
+}
+
+
+/**
+ * Write back to the L3 cache, only called when the hierarchy has one
+*/
+void write_l3_cache(CacheSim* sim, unsigned long int address, unsigned long int* data) {
+    PROFILE_SCOPE(PROFILE_L3);
+    charge_access(sim, PART_L3);
+
+    sim->stats.simulation_clock += L3_ACCESS_TIME;
+
+    CacheLevel* cache = &sim->l3_cache;
+    size_t setIndex = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    size_t base = level_entry(cache, setIndex, 0);
+
+    long way = level_lookup(cache, setIndex, tag);
+    classify_access(sim, CLASS_L3, address, way >= 0);
+    if (way >= 0) {
+        sim->stats.l3_hits++;
+        fill_data(cache, base + way, data);
+        level_set_bit(cache->dirty, base + way, 1);
+        policy_touch(cache, setIndex, way);
+        return;
+    }
+
+    sim->stats.l3_misses++;
+    size_t victim_way = policy_victim(cache, setIndex);
+    size_t victim = base + victim_way;
+
+    if (level_bit(cache->dirty, victim)) {
+        write_dram(sim, address, level_data(cache, victim));
+    }
+
+    level_fill(cache, setIndex, victim_way, tag);
+    level_set_bit(cache->dirty, victim, 1);
+    fill_data(cache, victim, data);
+    policy_insert(cache, setIndex, victim_way);
+}
+
+
+/**
+ * "Write" to DRAM
+*/
+void write_dram(CacheSim* sim, unsigned long int address, unsigned long int* data) {
+    PROFILE_SCOPE(PROFILE_DRAM);
+    charge_access(sim, PART_DRAM);
+
+    sim->stats.dram_hits++;
+    // no time incurred for dram write
+
+    // no image to write into without payloads
+    if (sim->config.tags_only) {
+        return;
+    }
+
+    // using a dummy write
+    unsigned long int block_size = sim->config.block_size;
+    memcpy(dram_image(sim) + (address % DRAM_SIZE & ~(block_size - 1)), data, block_size);
+}
+
+
+/**
+ * The DRAM image, mapped on first use.
+ * The image is only reserved, pages appear as they are written.
+*/
+unsigned char* dram_image(CacheSim* sim) {
+    if (sim->dram == NULL) {
+        sim->dram = mmap(NULL, DRAM_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (sim->dram == MAP_FAILED) {
+            fprintf(stderr, "Unable to map DRAM\n");
+            exit(1);
+        }
+    }
+    return sim->dram;
+}
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Non-blocking timing model
+ * Every access still runs through the serial model, which advances
+ * simulation_clock by the whole miss path. With issue_window set, the
+ * TimingModel overlaps those latencies (timing.h).
+*/
+
+
+/**
+ * Empty the MSHRs and the issue window
+*/
+static void reset_timing(CacheSim* sim) {
+    const CacheConfig* config = &sim->config;
+    if (config->issue_window == 0) {
+        return;
+    }
+    int mshrs[NUM_MSHR_FILES] = { config->l1i.mshrs, config->l1d.mshrs, config->l2.mshrs, config->l3.mshrs };
+    timing_reset(&sim->timing, config->issue_window, mshrs);
+}
+
+
+/**
+ * Note the serial clock and miss counts before an access
+*/
+static void timing_begin(const CacheSim* sim, TimingMark* mark) {
+    if (sim->config.issue_window == 0) {
+        return;
+    }
+    mark->clock = sim->stats.simulation_clock;
+    mark->l1_misses = sim->stats.l1_icache_misses + sim->stats.l1_dcache_misses;
+    mark->l2_misses = sim->stats.l2_misses;
+    mark->l3_misses = sim->stats.l3_misses;
+}
+
+
+/**
+ * Time an access in the non-blocking model from what it did since timing_begin
+*/
+static void timing_end(CacheSim* sim, const TimingMark* mark, int opcode, unsigned long int address) {
+    if (sim->config.issue_window == 0 || opcode > INSTR_FETCH) {
+        return;
+    }
+    const CacheStats* stats = &sim->stats;
+    int l1 = opcode == INSTR_FETCH ? MSHR_L1I : MSHR_L1D;
+    unsigned int missed = 0;
+    if (stats->l1_icache_misses + stats->l1_dcache_misses != mark->l1_misses) {
+        missed |= 1u << l1;
+    }
+    if (stats->l2_misses != mark->l2_misses) {
+        missed |= 1u << MSHR_L2;
+    }
+    if (stats->l3_misses != mark->l3_misses) {
+        missed |= 1u << MSHR_L3;
+    }
+    timing_access(&sim->timing, &sim->stats.timing, l1, missed,
+        address >> sim->l1_data_cache.block_shift, stats->simulation_clock - mark->clock);
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Prefetchers of the L1 dcache and the L2
+ * A prefetch reads the level below like a miss and is charged like one,
+ * but the clock doesn't wait for it: the block just can't be used before
+ * the time the fetch would have taken has passed.
+*/
+
+
+/**
+ * A demand access found a way. If a prefetch brought it in, it was useful,
+ * and late if its fill is still on the way, which the access waits out.
+ * Returns 1 on the first use of a prefetched block.
+*/
+static int prefetch_use(CacheSim* sim, CacheLevel* cache, PrefetchStats* stats, size_t entry) {
+    if (!cache->prefetched || !level_bit(cache->prefetched, entry)) {
+        return 0;
+    }
+    level_set_bit(cache->prefetched, entry, 0);
+    stats->useful++;
+    if (cache->ready[entry] > sim->stats.simulation_clock) {
+        stats->late++;
+        sim->stats.simulation_clock = cache->ready[entry];
+    }
+    return 1;
+}
+
+
+/**
+ * A way is about to be replaced, a prefetched block in it was never used
+*/
+static void prefetch_evict(CacheLevel* cache, PrefetchStats* stats, size_t entry) {
+    if (cache->prefetched && level_bit(cache->prefetched, entry)) {
+        level_set_bit(cache->prefetched, entry, 0);
+        stats->useless++;
+    }
+}
+
+
+/**
+ * Fetch a block for a level's prefetcher from the level below.
+ * Returns the payload, and when it arrives in ready.
+*/
+static unsigned long int* prefetch_fetch(CacheSim* sim, CacheLevel* cache, PrefetchStats* stats,
+                                         unsigned long int address, double* ready) {
+    double clock = sim->stats.simulation_clock;
+    unsigned long int dram_reads = sim->stats.dram_hits;
+    stats->issued++;
+
+    unsigned long int* data;
+    sim->prefetching = 1;
+    if (cache == &sim->l1_data_cache) {
+        data = read_l2_cache(sim, address);
+    } else if (sim->has_l3) {
+        data = read_l3_cache(sim, address);
+    } else {
+        data = read_dram(sim, address);
+    }
+    sim->prefetching = 0;
+
+    *ready = sim->stats.simulation_clock;
+    sim->stats.simulation_clock = clock;
+    stats->dram_reads += sim->stats.dram_hits - dram_reads;
+    return data;
+}
+
+
+/**
+ * Bring a block into a level ahead of demand, unless it's there already
+*/
+static void prefetch_fill(CacheSim* sim, CacheLevel* cache, PrefetchStats* stats, unsigned long int block) {
+    unsigned long int address = block << cache->block_shift;
+    size_t set = level_set_index(cache, address);
+    int tag = level_tag(cache, address);
+    if (level_lookup(cache, set, tag) >= 0) {
+        return;
+    }
+
+    double ready;
+    unsigned long int* data = prefetch_fetch(sim, cache, stats, address, &ready);
+    sim->stats.energy.fills[cache == &sim->l1_data_cache ? PART_L1D : PART_L2]++;
+
+    size_t way = policy_victim(cache, set);
+    size_t entry = level_entry(cache, set, way);
+    prefetch_evict(cache, stats, entry);
+    level_fill(cache, set, way, tag);
+    level_set_bit(cache->dirty, entry, 0);
+    fill_data(cache, entry, data);
+    policy_insert(cache, set, way);
+
+    level_set_bit(cache->prefetched, entry, 1);
+    cache->ready[entry] = ready;
+}
+
+
+/**
+ * A demand miss: with stream buffers, take the block from the head of a
+ * stream (waiting for it if it's still on the way) instead of the level
+ * below. Stream buffers hold no payloads. Returns 1 if a stream had it.
+*/
+static int prefetch_stream_hit(CacheSim* sim, Prefetcher* prefetcher, CacheLevel* cache, PrefetchStats* stats,
+                               unsigned long int address) {
+    if (prefetcher->kind == PREFETCH_NONE) {
+        return 0;
+    }
+
+    double ready;
+    if (prefetcher->kind != PREFETCH_STREAM || !stream_take(prefetcher, address >> cache->block_shift, &ready)) {
+        stats->misses++;
+        return 0;
+    }
+    stats->useful++;
+    if (ready > sim->stats.simulation_clock) {
+        stats->late++;
+        sim->stats.simulation_clock = ready;
+    }
+    return 1;
+}
+
+
+/**
+ * Let a level's prefetcher see a demand access and fetch what it picks.
+ * trigger: a miss, or the first use of a prefetched block.
+*/
+static void prefetch_train(CacheSim* sim, Prefetcher* prefetcher, CacheLevel* cache, PrefetchStats* stats,
+                           unsigned long int address, int trigger) {
+    unsigned long int block = address >> cache->block_shift;
+
+    // misses keep a stream going after the block, or start one
+    if (prefetcher->kind == PREFETCH_STREAM) {
+        if (trigger) {
+            StreamBuffer* stream = stream_for(prefetcher, block + 1, &stats->useless);
+            while (stream->count < prefetcher->degree) {
+                double ready;
+                prefetch_fetch(sim, cache, stats, stream_next_block(stream) << cache->block_shift, &ready);
+                stream_append(stream, ready);
+            }
+        }
+        return;
+    }
+
+    unsigned long int blocks[MAX_PREFETCH_DEGREE];
+    size_t count = prefetch_candidates(prefetcher, block, trigger, blocks);
+    for (size_t i = 0; i < count; i++) {
+        prefetch_fill(sim, cache, stats, blocks[i]);
+    }
+}
+
+
+/**
+ * Count an access to one part, every other part idles through it
+*/
+static void charge_access(CacheSim* sim, int part) {
+    sim->stats.energy.ticks++;
+    sim->stats.energy.active[part]++;
+}
+
+
+/**
+ * Count a cycle with every part idle
+*/
+static void charge_idle(CacheSim* sim) {
+    sim->stats.energy.ticks++;
+}
+
+
+/**
+ * Proccess input trace file in Din 3 format
+*/
+void process_trace_file(const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to open trace file\n");
+        exit(1);
+    }
+
+    char operation;
+    unsigned long int address;
+
+
+    while (fscanf(file, "%c %lx\n", &operation, &address) == 2) {
+        // ex
+        printf("Operation: %c, Address: 0x%lx\n", operation, address);
+    }
+
+    fclose(file);
+}
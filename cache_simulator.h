@@ -1,51 +1,172 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-
-// system defs
-#define L1_INSTRUCTION_CACHE_SIZE 32768  // 32KB
-#define L1_DATA_CACHE_SIZE 32768         // 32KB
-#define L2_CACHE_SIZE 262144             // 256KB
-#define BLOCK_SIZE 64                    // cache block size of 64 bytes
-
-#define L1_INSTRUCTION_NUM_BLOCKS (L1_INSTRUCTION_CACHE_SIZE / BLOCK_SIZE)
-#define L1_DATA_NUM_BLOCKS (L1_DATA_CACHE_SIZE / BLOCK_SIZE)
-#define L2_NUM_BLOCKS (L2_CACHE_SIZE / BLOCK_SIZE)
-#define DEFAULT_ASSOCIATIVITY 4
-#define NUM_SETS (L2_NUM_BLOCKS / DEFAULT_ASSOCIATIVITY)
-
-// debug mode
-#define DEBUG 0
-
-// opcodes
-#define MEMORY_READ  0
-#define MEMORY_WRITE 1
-#define INSTR_FETCH  2
-#define IGNORE       3
-#define FLUSH_CACHE  4
-
-// cache block struct
-typedef struct {
-    int valid;
-    int dirty;
-    int tag;
-    int unsigned long data[BLOCK_SIZE / sizeof(int)]; // int is 4 bytes
-} CacheBlock;
-
-// energy consumption
-#define L1_RW_ENERGY 1
-#define L2_RW_ENERGY 2
-#define DRAM_RW_ENERGY 4
-#define L1_IDLE_ENERGY 0.5
-#define L2_IDLE_ENERGY 0.8
-#define DRAM_IDLE_ENERGY 0.8
-
-// access times in nanoseconds
-#define ONE_CYCLE 0.5
-#define L1_ACCESS_TIME 0.5
-#define L2_ACCESS_TIME 4.5
-#define DRAM_ACCESS_TIME 45
-#define WRITE_TIME 5
-
-#define DRAM_SIZE (1 * 1024 * 1024 * 1024)  // 1GB
+#ifndef CACHE_SIMULATOR_H
+#define CACHE_SIMULATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "./cache_level.h"
+#include "./classify.h"
+#include "./config.h"
+#include "./energy.h"
+#include "./prefetch.h"
+#include "./replacement.h"
+#include "./timing.h"
+#include "./trace.h"
+
+// default system defs, a config file or flags can change them (config.h)
+#define L1_INSTRUCTION_CACHE_SIZE 32768  // 32KB
+#define L1_DATA_CACHE_SIZE 32768         // 32KB
+#define L2_CACHE_SIZE 262144             // 256KB
+#define L3_CACHE_SIZE 0                  // no L3
+#define BLOCK_SIZE 64                    // cache block size of 64 bytes
+#define MAX_BLOCK_SIZE 4096
+
+#define DEFAULT_ASSOCIATIVITY 4
+#define L3_ASSOCIATIVITY 16
+
+// debug mode
+#define DEBUG 0
+
+// opcodes
+#define MEMORY_READ  0
+#define MEMORY_WRITE 1
+#define INSTR_FETCH  2
+#define IGNORE       3
+#define FLUSH_CACHE  4
+
+// energy consumption, the default EnergyModel (energy.h)
+#define L1_RW_ENERGY 1
+#define L2_RW_ENERGY 2
+#define L3_RW_ENERGY 3
+#define DRAM_RW_ENERGY 4
+#define L1_IDLE_ENERGY 0.5
+#define L2_IDLE_ENERGY 0.8
+#define L3_IDLE_ENERGY 0.8
+#define DRAM_IDLE_ENERGY 0.8
+#define L2_STATIC_PER_L1I_FILL 5
+#define DRAM_STATIC_PER_READ 640
+
+// access times in nanoseconds
+#define ONE_CYCLE 0.5
+#define L1_ACCESS_TIME 0.5
+#define L2_ACCESS_TIME 4.5
+#define L3_ACCESS_TIME 15
+#define DRAM_ACCESS_TIME 45
+#define WRITE_TIME 5
+
+#define DRAM_SIZE (1 * 1024 * 1024 * 1024)  // 1GB
+
+// most configurations in one --sweep
+#define MAX_SWEEP_CONFIGS 64
+
+// records decoded ahead and run through every configuration
+#define SWEEP_BATCH_SIZE 4096
+
+// accesses ahead of the current one whose sets cache_access_batch prefetches
+#define BATCH_PREFETCH_DISTANCE 8
+
+// counters and energy of one run
+typedef struct {
+    unsigned long int l1_icache_misses;
+    unsigned long int l1_dcache_misses;
+    unsigned long int l2_misses;
+    unsigned long int l3_misses;
+
+    unsigned long int l1_icache_hits;
+    unsigned long int l1_dcache_hits;
+    unsigned long int l2_hits;
+    unsigned long int l3_hits;
+    unsigned long int dram_hits;
+
+    // priced when printed
+    EnergyCounters energy;
+
+    // prefetchers of the L1 dcache and the L2 (prefetch.h)
+    PrefetchStats l1d_prefetch;
+    PrefetchStats l2_prefetch;
+
+    // clock
+    double simulation_clock;
+
+    // non-blocking timing model, with issue_window (timing.h)
+    TimingStats timing;
+
+    // compulsory, capacity and conflict misses of each level, with classify (CLASS_*)
+    MissClasses classes[NUM_CLASSIFIED];
+} CacheStats;
+
+// one independent simulated hierarchy
+typedef struct {
+    CacheConfig config;
+
+    // cache data, geometry from config
+    CacheLevel l1_instruction_cache;
+    CacheLevel l1_data_cache;
+    CacheLevel l2_cache;
+    CacheLevel l3_cache;                // only if has_l3
+    int has_l3;
+
+    // block handed back by read_dram, block written by a store (block_size bytes)
+    int* dram_block;
+    unsigned long int* write_block;
+
+    // dummy data random state, replacement state lives in each level
+    unsigned int data_seed;
+
+    // stats
+    CacheStats stats;
+
+    // lazily mapped DRAM image, NULL until the first write back
+    unsigned char* dram;
+
+    // while capturing (miss_stream.h), what the L1s send the L2 is written here instead
+    TraceWriter* l1_misses;
+
+    // prefetchers, and set while one fetches so the L2's doesn't train on the L1's
+    Prefetcher l1d_prefetcher;
+    Prefetcher l2_prefetcher;
+    int prefetching;
+
+    // non-blocking timing model, with issue_window
+    TimingModel timing;
+
+    // fully associative shadows of each level (CLASS_*), NULL unless classify
+    ShadowCache* shadows;
+} CacheSim;
+
+// run_dinero_trace status
+#define RUN_OK           0
+#define RUN_OPEN_FAILED  1
+#define RUN_MALFORMED    2
+#define RUN_INVALID_OP   3
+#define RUN_SEEK_FAILED  4      // a checkpoint's trace position isn't in the trace
+
+// outcome of one pass over a trace
+typedef struct {
+    int status;
+    unsigned long int records;  // records simulated
+    unsigned long int line;     // line of the failing record for RUN_MALFORMED
+    TraceRecord record;         // failing record for RUN_INVALID_OP
+} RunResult;
+
+// simulator instances
+CacheSim* create_simulator(const CacheConfig* config);
+void destroy_simulator(CacheSim* sim);
+
+// simulation
+RunResult run_dinero_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims);
+int simulate_record(CacheSim* sim, const TraceRecord* record);
+size_t simulate_records(CacheSim* sim, const TraceRecord* records, size_t count);
+int record_valid(const TraceRecord* record);
+int replay_l1_miss(CacheSim* sim, const TraceRecord* record);
+void add_stats(CacheStats* total, const CacheStats* stats);
+size_t cache_access_batch(CacheSim* sim, const uint64_t* addrs, const uint8_t* ops, size_t n);
+unsigned char* dram_image(CacheSim* sim);
+
+// the levels below the L1s, multicore.c shares them between cores
+unsigned long int* read_l2_cache(CacheSim* sim, unsigned long int address);
+void write_l2_cache(CacheSim* sim, unsigned long int address, unsigned long int* data);
+
+#endif
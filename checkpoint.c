@@ -0,0 +1,528 @@
+#define _DEFAULT_SOURCE
+
+#include <unistd.h>
+
+#include "./checkpoint.h"
+
+
+// an open checkpoint, saved and loaded through the same field lists
+typedef struct {
+    FILE* file;
+    int loading;
+    int failed;
+} CheckpointFile;
+
+
+/**
+ * Store a little endian integer
+*/
+static void store_le(unsigned char* p, unsigned long int value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+
+/**
+ * Read a little endian integer
+*/
+static unsigned long int load_le(const unsigned char* p, int bytes) {
+    unsigned long int value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+
+/**
+ * Read or write raw bytes, remembering the first failure
+*/
+static void transfer(CheckpointFile* f, void* data, size_t bytes) {
+    if (f->failed || bytes == 0) {
+        return;
+    }
+    size_t done = f->loading ? fread(data, 1, bytes, f->file) : fwrite(data, 1, bytes, f->file);
+    if (done != bytes) {
+        f->failed = 1;
+    }
+}
+
+
+/**
+ * Read or write one little endian u64 field
+*/
+static void transfer_u64(CheckpointFile* f, unsigned long int* value) {
+    unsigned char bytes[8];
+    if (!f->loading) {
+        store_le(bytes, *value, 8);
+    }
+    transfer(f, bytes, sizeof(bytes));
+    if (f->loading && !f->failed) {
+        *value = load_le(bytes, 8);
+    }
+}
+
+static void transfer_int(CheckpointFile* f, int* value) {
+    unsigned long int field = (unsigned int) *value;
+    transfer_u64(f, &field);
+    *value = (int) field;
+}
+
+static void transfer_uint(CheckpointFile* f, unsigned int* value) {
+    unsigned long int field = *value;
+    transfer_u64(f, &field);
+    *value = (unsigned int) field;
+}
+
+static void transfer_double(CheckpointFile* f, double* value) {
+    unsigned long int field;
+    memcpy(&field, value, sizeof(field));
+    transfer_u64(f, &field);
+    memcpy(value, &field, sizeof(field));
+}
+
+
+/**
+ * Number of simulators, records simulated and the trace position
+*/
+static void transfer_mark(CheckpointFile* f, unsigned long int* num_sims, CheckpointMark* mark) {
+    TracePosition* position = &mark->position;
+    transfer_u64(f, num_sims);
+    transfer_u64(f, &mark->records);
+    transfer_int(f, &position->binary);
+    transfer_u64(f, &position->size);
+    transfer_u64(f, &position->offset);
+    transfer_u64(f, &position->line);
+    transfer_u64(f, &position->records_left);
+    for (int i = 0; i < TRACE_NUM_STREAMS; i++) {
+        transfer_u64(f, &position->last_address[i]);
+    }
+}
+
+
+/**
+ * Configuration of a simulator
+*/
+static void transfer_config(CheckpointFile* f, CacheConfig* config) {
+    LevelConfig* levels[4] = { &config->l1i, &config->l1d, &config->l2, &config->l3 };
+    transfer_u64(f, &config->block_size);
+    for (int i = 0; i < 4; i++) {
+        transfer_u64(f, &levels[i]->size);
+        transfer_u64(f, &levels[i]->associativity);
+        transfer_int(f, &levels[i]->policy);
+        transfer_int(f, &levels[i]->prefetch);
+        transfer_int(f, &levels[i]->mshrs);
+    }
+    transfer_int(f, &config->tags_only);
+    transfer_int(f, &config->prefetch_degree);
+    transfer_int(f, &config->issue_window);
+    transfer_int(f, &config->classify);
+    transfer_u64(f, &config->indexed_ways);
+}
+
+
+/**
+ * Counters and clock of a simulator
+*/
+static void transfer_stats(CheckpointFile* f, CacheStats* stats) {
+    transfer_u64(f, &stats->l1_icache_misses);
+    transfer_u64(f, &stats->l1_dcache_misses);
+    transfer_u64(f, &stats->l2_misses);
+    transfer_u64(f, &stats->l3_misses);
+    transfer_u64(f, &stats->l1_icache_hits);
+    transfer_u64(f, &stats->l1_dcache_hits);
+    transfer_u64(f, &stats->l2_hits);
+    transfer_u64(f, &stats->l3_hits);
+    transfer_u64(f, &stats->dram_hits);
+    transfer_u64(f, &stats->energy.ticks);
+    for (int part = 0; part < NUM_PARTS; part++) {
+        transfer_u64(f, &stats->energy.active[part]);
+    }
+    for (int part = 0; part < NUM_PARTS; part++) {
+        transfer_u64(f, &stats->energy.fills[part]);
+    }
+    transfer_double(f, &stats->simulation_clock);
+
+    PrefetchStats* prefetch[2] = { &stats->l1d_prefetch, &stats->l2_prefetch };
+    for (int i = 0; i < 2; i++) {
+        transfer_u64(f, &prefetch[i]->issued);
+        transfer_u64(f, &prefetch[i]->useful);
+        transfer_u64(f, &prefetch[i]->late);
+        transfer_u64(f, &prefetch[i]->useless);
+        transfer_u64(f, &prefetch[i]->misses);
+        transfer_u64(f, &prefetch[i]->dram_reads);
+    }
+
+    TimingStats* timing = &stats->timing;
+    transfer_double(f, &timing->clock);
+    transfer_u64(f, &timing->misses);
+    transfer_u64(f, &timing->merged);
+    transfer_double(f, &timing->miss_latency);
+    transfer_double(f, &timing->miss_busy);
+    transfer_double(f, &timing->mshr_stall);
+
+    for (int i = 0; i < NUM_CLASSIFIED; i++) {
+        transfer_u64(f, &stats->classes[i].compulsory);
+        transfer_u64(f, &stats->classes[i].capacity);
+        transfer_u64(f, &stats->classes[i].conflict);
+    }
+}
+
+
+/**
+ * Contents of a level, its geometry comes from the configuration
+*/
+static void transfer_level(CheckpointFile* f, CacheLevel* level) {
+    size_t entries = level->num_sets * level->associativity;
+    size_t bit_words = (entries + 63) / 64;
+
+    transfer_uint(f, &level->seed);
+    transfer(f, level->tags, entries * sizeof(int));
+    transfer(f, level->valid, bit_words * sizeof(uint64_t));
+    transfer(f, level->dirty, bit_words * sizeof(uint64_t));
+    transfer(f, level->policy_state, level->num_sets * level->state_words * sizeof(uint64_t));
+    if (level->data) {
+        transfer(f, level->data, entries * level->block_size);
+    }
+    if (level->prefetched) {
+        transfer(f, level->prefetched, bit_words * sizeof(uint64_t));
+        transfer(f, level->ready, entries * sizeof(double));
+    }
+    if (level->index) {
+        transfer(f, level->index, level->num_sets * level->index_size * sizeof(uint32_t));
+        transfer(f, level->invalid_from, level->num_sets * sizeof(uint32_t));
+        transfer_u64(f, &level->duplicates);
+    }
+    if (level->lru_next) {
+        transfer(f, level->lru_prev, entries * sizeof(uint32_t));
+        transfer(f, level->lru_next, entries * sizeof(uint32_t));
+        transfer(f, level->lru_head, level->num_sets * sizeof(uint32_t));
+        transfer(f, level->lru_tail, level->num_sets * sizeof(uint32_t));
+    }
+}
+
+
+/**
+ * LRU list, table and seen set of a shadow, its capacity comes from the
+ * configuration, the seen set is resized to the saved one
+*/
+static void transfer_shadow(CheckpointFile* f, ShadowCache* shadow) {
+    unsigned long int seen_size = shadow->seen_size;
+    unsigned long int seen_used = shadow->seen_used;
+    transfer_u64(f, &seen_size);
+    transfer_u64(f, &seen_used);
+    if (f->loading && !f->failed) {
+        if (seen_size < SEEN_INITIAL_SIZE || (seen_size & (seen_size - 1)) != 0 || 2 * seen_used > seen_size) {
+            f->failed = 1;
+            return;
+        }
+        unsigned long int* seen = realloc(shadow->seen, seen_size * sizeof(unsigned long int));
+        if (!seen) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        shadow->seen = seen;
+        shadow->seen_size = seen_size;
+        shadow->seen_used = seen_used;
+    }
+    transfer(f, shadow->seen, shadow->seen_size * sizeof(unsigned long int));
+
+    transfer(f, &shadow->count, sizeof(shadow->count));
+    transfer(f, &shadow->head, sizeof(shadow->head));
+    transfer(f, &shadow->tail, sizeof(shadow->tail));
+    if (shadow->count > shadow->capacity) {
+        f->failed = 1;
+        return;
+    }
+    transfer(f, shadow->blocks, shadow->count * sizeof(unsigned long int));
+    transfer(f, shadow->prev, shadow->count * sizeof(uint32_t));
+    transfer(f, shadow->next, shadow->count * sizeof(uint32_t));
+    transfer(f, shadow->table, shadow->table_size * sizeof(uint32_t));
+}
+
+
+/**
+ * Is a page all zero
+*/
+static int page_is_zero(const unsigned char* page, size_t size) {
+    const uint64_t* words = (const uint64_t*) page;
+    for (size_t i = 0; i < size / sizeof(uint64_t); i++) {
+        if (words[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Write the pages of the DRAM image holding anything.
+ * Reading pages never written maps the shared zero page, nothing is allocated.
+*/
+static void save_dram(CheckpointFile* f, CacheSim* sim) {
+    unsigned long int page_size = sysconf(_SC_PAGESIZE);
+    unsigned long int num_pages = 0;
+    unsigned long int* pages = NULL;
+
+    if (sim->dram) {
+        size_t total = DRAM_SIZE / page_size;
+        pages = malloc(total * sizeof(unsigned long int));
+        if (!pages) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        for (size_t p = 0; p < total; p++) {
+            if (!page_is_zero(sim->dram + p * page_size, page_size)) {
+                pages[num_pages++] = p;
+            }
+        }
+    }
+
+    transfer_u64(f, &page_size);
+    transfer_u64(f, &num_pages);
+    for (unsigned long int i = 0; i < num_pages; i++) {
+        transfer_u64(f, &pages[i]);
+        transfer(f, sim->dram + pages[i] * page_size, page_size);
+    }
+    free(pages);
+}
+
+
+/**
+ * Read the saved pages back into the DRAM image
+*/
+static void load_dram(CheckpointFile* f, CacheSim* sim) {
+    unsigned long int page_size = 0;
+    unsigned long int num_pages = 0;
+    transfer_u64(f, &page_size);
+    transfer_u64(f, &num_pages);
+    if (num_pages > 0 && (page_size == 0 || DRAM_SIZE % page_size != 0 || sim->config.tags_only)) {
+        f->failed = 1;
+    }
+
+    for (unsigned long int i = 0; i < num_pages && !f->failed; i++) {
+        unsigned long int page = DRAM_SIZE;
+        transfer_u64(f, &page);
+        if (page >= DRAM_SIZE / page_size) {
+            f->failed = 1;
+            break;
+        }
+        transfer(f, dram_image(sim) + page * page_size, page_size);
+    }
+}
+
+
+/**
+ * Everything a simulator holds but its configuration
+*/
+static void transfer_sim(CheckpointFile* f, CacheSim* sim) {
+    transfer_stats(f, &sim->stats);
+    transfer_uint(f, &sim->data_seed);
+    transfer_level(f, &sim->l1_instruction_cache);
+    transfer_level(f, &sim->l1_data_cache);
+    transfer_level(f, &sim->l2_cache);
+    if (sim->has_l3) {
+        transfer_level(f, &sim->l3_cache);
+    }
+    // plain data, only read back into the same build and configuration
+    transfer(f, &sim->l1d_prefetcher, sizeof(Prefetcher));
+    transfer(f, &sim->l2_prefetcher, sizeof(Prefetcher));
+    transfer(f, &sim->timing, sizeof(TimingModel));
+    if (sim->shadows) {
+        for (int i = 0; i < NUM_CLASSIFIED; i++) {
+            transfer_shadow(f, &sim->shadows[i]);
+        }
+    }
+    if (f->loading) {
+        load_dram(f, sim);
+    } else {
+        save_dram(f, sim);
+    }
+}
+
+
+/**
+ * Same geometry and policy, an absent L3 matches any absent L3
+*/
+static int same_level(const LevelConfig* a, const LevelConfig* b) {
+    if (a->size == 0 || b->size == 0) {
+        return a->size == b->size;
+    }
+    return a->size == b->size && a->associativity == b->associativity && a->policy == b->policy
+        && a->prefetch == b->prefetch && a->mshrs == b->mshrs;
+}
+
+static int same_config(const CacheConfig* a, const CacheConfig* b) {
+    return a->block_size == b->block_size && a->tags_only == b->tags_only
+        && a->prefetch_degree == b->prefetch_degree && a->issue_window == b->issue_window
+        && a->classify == b->classify && a->indexed_ways == b->indexed_ways
+        && same_level(&a->l1i, &b->l1i) && same_level(&a->l1d, &b->l1d)
+        && same_level(&a->l2, &b->l2) && same_level(&a->l3, &b->l3);
+}
+
+
+/**
+ * Parse --checkpoint=records:file.
+ * Returns 0 on success, -1 on garbage.
+*/
+int parse_checkpoint(const char* spec, CheckpointPlan* plan) {
+    char* end;
+    unsigned long int records = strtoul(spec, &end, 10);
+    if (end == spec || *end != ':' || end[1] == '\0') {
+        return -1;
+    }
+    plan->save_at = records;
+    plan->save = end + 1;
+    return 0;
+}
+
+
+/**
+ * Write every simulator's state and where the trace stopped.
+ * Returns 0 on success, -1 if the file can't be written.
+*/
+int save_checkpoint(const char* filename, CacheSim** sims, size_t num_sims, const CheckpointMark* mark) {
+    CheckpointFile f = { fopen(filename, "wb"), 0, 0 };
+    if (f.file == NULL) {
+        return -1;
+    }
+
+    unsigned char header[8];
+    memcpy(header, CHECKPOINT_MAGIC, 4);
+    store_le(header + 4, CHECKPOINT_VERSION, 4);
+    transfer(&f, header, sizeof(header));
+
+    unsigned long int count = num_sims;
+    CheckpointMark saved = *mark;
+    transfer_mark(&f, &count, &saved);
+    for (size_t i = 0; i < num_sims; i++) {
+        CacheConfig config = sims[i]->config;
+        transfer_config(&f, &config);
+        transfer_sim(&f, sims[i]);
+    }
+
+    if (fclose(f.file) != 0) {
+        f.failed = 1;
+    }
+    return f.failed ? -1 : 0;
+}
+
+
+/**
+ * Load a checkpoint into simulators created with the configurations it was
+ * saved from. Returns 0 on success, -1 with the reason in error if not.
+*/
+int load_checkpoint(const char* filename, CacheSim** sims, size_t num_sims, CheckpointMark* mark,
+                    char* error, size_t error_size) {
+    CheckpointFile f = { fopen(filename, "rb"), 1, 0 };
+    if (f.file == NULL) {
+        snprintf(error, error_size, "unable to open %s", filename);
+        return -1;
+    }
+
+    unsigned char header[8];
+    transfer(&f, header, sizeof(header));
+    if (f.failed || memcmp(header, CHECKPOINT_MAGIC, 4) != 0 || load_le(header + 4, 4) != CHECKPOINT_VERSION) {
+        snprintf(error, error_size, "%s isn't a version %d checkpoint", filename, CHECKPOINT_VERSION);
+        fclose(f.file);
+        return -1;
+    }
+
+    unsigned long int count = 0;
+    memset(mark, 0, sizeof(*mark));
+    transfer_mark(&f, &count, mark);
+    if (!f.failed && count != num_sims) {
+        snprintf(error, error_size, "%s holds %lu configurations, not %zu", filename, count, num_sims);
+        fclose(f.file);
+        return -1;
+    }
+
+    for (size_t i = 0; i < num_sims && !f.failed; i++) {
+        CacheConfig config;
+        memset(&config, 0, sizeof(config));
+        transfer_config(&f, &config);
+        if (!f.failed && !same_config(&config, &sims[i]->config)) {
+            snprintf(error, error_size, "configuration %zu isn't the one checkpointed", i + 1);
+            fclose(f.file);
+            return -1;
+        }
+        transfer_sim(&f, sims[i]);
+    }
+
+    fclose(f.file);
+    if (f.failed) {
+        snprintf(error, error_size, "%s is truncated or corrupt", filename);
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Run a trace through every simulator from start (NULL for the beginning)
+ * up to stop trace records (0 to run to the end), and tell where it got to
+ * in end. The records in the result count those before start too.
+*/
+RunResult run_checkpointed_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                                 const CheckpointMark* start, unsigned long int stop, CheckpointMark* end) {
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+
+    TraceReader reader;
+    if (trace_open(&reader, filename, reader_kind) != 0) {
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+    if (start) {
+        if (trace_seek(&reader, &start->position) != 0) {
+            trace_close(&reader);
+            result.status = RUN_SEEK_FAILED;
+            return result;
+        }
+        result.records = start->records;
+    }
+
+    TraceRecord* batch = malloc(SWEEP_BATCH_SIZE * sizeof(TraceRecord));
+    if (!batch) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    int status = TRACE_RECORD;
+    while (status == TRACE_RECORD && result.status == RUN_OK && (stop == 0 || result.records < stop)) {
+        // never read past the stop, the position has to be right after it
+        size_t wanted = SWEEP_BATCH_SIZE;
+        if (stop && stop - result.records < wanted) {
+            wanted = stop - result.records;
+        }
+
+        size_t count = 0;
+        while (count < wanted && (status = trace_next(&reader, &batch[count])) == TRACE_RECORD) {
+            count++;
+        }
+
+        for (size_t i = 0; i < num_sims && result.status == RUN_OK; i++) {
+            size_t done = simulate_records(sims[i], batch, count);
+            if (done < count) {
+                result.status = RUN_INVALID_OP;
+                result.record = batch[done];
+            }
+        }
+        result.records += count;
+    }
+
+    if (result.status == RUN_OK && status == TRACE_MALFORMED) {
+        result.status = RUN_MALFORMED;
+        result.line = reader.line;
+    }
+    if (end) {
+        end->records = result.records;
+        trace_tell(&reader, &end->position);
+    }
+
+    free(batch);
+    trace_close(&reader);
+    return result;
+}
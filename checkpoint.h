@@ -0,0 +1,36 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "./cache_simulator.h"
+
+// checkpoint file
+//
+// header: "CKPT" magic, u32 version, then little endian u64 fields: number
+//         of simulators, records simulated and the trace position
+// simulator: its configuration and stats as u64 fields, then every level's
+//         seed, tags, valid and dirty bits, replacement state and payloads
+//         in host byte order, then the written pages of the DRAM image
+#define CHECKPOINT_MAGIC   "CKPT"
+#define CHECKPOINT_VERSION 5
+
+// where a run stopped or resumes
+typedef struct {
+    unsigned long int records;  // trace records simulated before it
+    TracePosition position;
+} CheckpointMark;
+
+// what --checkpoint and --restore asked for
+typedef struct {
+    const char* save;           // checkpoint to write, NULL for none
+    unsigned long int save_at;  // after this many trace records
+    const char* restore;        // checkpoint to start from, NULL for cold caches
+} CheckpointPlan;
+
+int parse_checkpoint(const char* spec, CheckpointPlan* plan);
+int save_checkpoint(const char* filename, CacheSim** sims, size_t num_sims, const CheckpointMark* mark);
+int load_checkpoint(const char* filename, CacheSim** sims, size_t num_sims, CheckpointMark* mark,
+                    char* error, size_t error_size);
+RunResult run_checkpointed_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                                 const CheckpointMark* start, unsigned long int stop, CheckpointMark* end);
+
+#endif
@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./classify.h"
+
+#define NO_NODE UINT32_MAX
+
+
+/**
+ * Slot a block hashes to in a table of size slots (a power of two)
+*/
+static size_t block_slot(unsigned long int block, size_t size) {
+    return (block * 0x9E3779B97F4A7C15UL >> 17) & (size - 1);
+}
+
+
+/**
+ * Shadow of a level holding capacity blocks
+*/
+void shadow_init(ShadowCache* shadow, unsigned long int capacity) {
+    memset(shadow, 0, sizeof(*shadow));
+    shadow->capacity = capacity ? capacity : 1;
+    shadow->table_size = 1;
+    while (shadow->table_size < 2 * (size_t) shadow->capacity) {
+        shadow->table_size <<= 1;
+    }
+    shadow->blocks = malloc(shadow->capacity * sizeof(unsigned long int));
+    shadow->prev = malloc(shadow->capacity * sizeof(uint32_t));
+    shadow->next = malloc(shadow->capacity * sizeof(uint32_t));
+    shadow->table = malloc(shadow->table_size * sizeof(uint32_t));
+    shadow->seen_size = SEEN_INITIAL_SIZE;
+    shadow->seen = malloc(shadow->seen_size * sizeof(unsigned long int));
+    if (!shadow->blocks || !shadow->prev || !shadow->next || !shadow->table || !shadow->seen) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    shadow_reset(shadow);
+}
+
+
+/**
+ * Empty the shadow and forget every block seen
+*/
+void shadow_reset(ShadowCache* shadow) {
+    shadow->count = 0;
+    shadow->head = NO_NODE;
+    shadow->tail = NO_NODE;
+    memset(shadow->table, 0, shadow->table_size * sizeof(uint32_t));
+    memset(shadow->seen, 0, shadow->seen_size * sizeof(unsigned long int));
+    shadow->seen_used = 0;
+}
+
+
+void shadow_free(ShadowCache* shadow) {
+    free(shadow->blocks);
+    free(shadow->prev);
+    free(shadow->next);
+    free(shadow->table);
+    free(shadow->seen);
+    memset(shadow, 0, sizeof(*shadow));
+}
+
+
+/**
+ * Add a block to the seen set. Returns 1 if it wasn't there.
+*/
+static int see_block(ShadowCache* shadow, unsigned long int block) {
+    if (2 * (shadow->seen_used + 1) > shadow->seen_size) {
+        unsigned long int* old = shadow->seen;
+        size_t old_size = shadow->seen_size;
+        shadow->seen_size *= 2;
+        shadow->seen = calloc(shadow->seen_size, sizeof(unsigned long int));
+        if (!shadow->seen) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        for (size_t i = 0; i < old_size; i++) {
+            if (old[i]) {
+                size_t slot = block_slot(old[i] - 1, shadow->seen_size);
+                while (shadow->seen[slot]) {
+                    slot = (slot + 1) & (shadow->seen_size - 1);
+                }
+                shadow->seen[slot] = old[i];
+            }
+        }
+        free(old);
+    }
+
+    size_t slot = block_slot(block, shadow->seen_size);
+    while (shadow->seen[slot]) {
+        if (shadow->seen[slot] == block + 1) {
+            return 0;
+        }
+        slot = (slot + 1) & (shadow->seen_size - 1);
+    }
+    shadow->seen[slot] = block + 1;
+    shadow->seen_used++;
+    return 1;
+}
+
+
+/**
+ * Table slot holding a block's node, or the empty slot where it would go
+*/
+static size_t table_find(const ShadowCache* shadow, unsigned long int block) {
+    size_t slot = block_slot(block, shadow->table_size);
+    while (shadow->table[slot] && shadow->blocks[shadow->table[slot] - 1] != block) {
+        slot = (slot + 1) & (shadow->table_size - 1);
+    }
+    return slot;
+}
+
+
+/**
+ * Empty a table slot, moving later entries of the probe run back into it
+*/
+static void table_remove(ShadowCache* shadow, size_t slot) {
+    size_t mask = shadow->table_size - 1;
+    size_t next = (slot + 1) & mask;
+    while (shadow->table[next]) {
+        size_t home = block_slot(shadow->blocks[shadow->table[next] - 1], shadow->table_size);
+        // the entry at next may fill the hole if its home isn't in (slot, next]
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            shadow->table[slot] = shadow->table[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    shadow->table[slot] = 0;
+}
+
+
+static void list_unlink(ShadowCache* shadow, uint32_t node) {
+    uint32_t prev = shadow->prev[node];
+    uint32_t next = shadow->next[node];
+    if (prev != NO_NODE) {
+        shadow->next[prev] = next;
+    } else {
+        shadow->head = next;
+    }
+    if (next != NO_NODE) {
+        shadow->prev[next] = prev;
+    } else {
+        shadow->tail = prev;
+    }
+}
+
+static void list_push_head(ShadowCache* shadow, uint32_t node) {
+    shadow->prev[node] = NO_NODE;
+    shadow->next[node] = shadow->head;
+    if (shadow->head != NO_NODE) {
+        shadow->prev[shadow->head] = node;
+    } else {
+        shadow->tail = node;
+    }
+    shadow->head = node;
+}
+
+
+/**
+ * Run one access of the level through its shadow, and classify it if the
+ * level missed: compulsory on the block's first reference, capacity if the
+ * fully associative LRU cache misses too, else conflict
+*/
+void shadow_access(ShadowCache* shadow, unsigned long int block, MissClasses* classes, int hit) {
+    int first = see_block(shadow, block);
+
+    size_t slot = table_find(shadow, block);
+    int shadow_hit = shadow->table[slot] != 0;
+    if (shadow_hit) {
+        uint32_t node = shadow->table[slot] - 1;
+        if (shadow->head != node) {
+            list_unlink(shadow, node);
+            list_push_head(shadow, node);
+        }
+    } else {
+        uint32_t node;
+        if (shadow->count < shadow->capacity) {
+            node = shadow->count++;
+        } else {
+            node = shadow->tail;
+            list_unlink(shadow, node);
+            table_remove(shadow, table_find(shadow, shadow->blocks[node]));
+            slot = table_find(shadow, block);
+        }
+        shadow->blocks[node] = block;
+        shadow->table[slot] = node + 1;
+        list_push_head(shadow, node);
+    }
+
+    if (hit) {
+        return;
+    }
+    if (first) {
+        classes->compulsory++;
+    } else if (shadow_hit) {
+        classes->conflict++;
+    } else {
+        classes->capacity++;
+    }
+}
+
+
+void add_miss_classes(MissClasses* total, const MissClasses* classes) {
+    total->compulsory += classes->compulsory;
+    total->capacity += classes->capacity;
+    total->conflict += classes->conflict;
+}
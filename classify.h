@@ -0,0 +1,49 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// levels whose misses are classified, with --classify-misses
+#define CLASS_L1I 0
+#define CLASS_L1D 1
+#define CLASS_L2  2
+#define CLASS_L3  3
+#define NUM_CLASSIFIED 4
+
+// blocks the seen set starts with room for, doubled whenever half are used
+#define SEEN_INITIAL_SIZE 4096
+
+// 3C split of one level's misses
+typedef struct {
+    unsigned long int compulsory;   // first reference to the block
+    unsigned long int capacity;     // would miss in a fully associative LRU cache of the same size too
+    unsigned long int conflict;     // would hit there
+} MissClasses;
+
+// fully associative LRU cache of a level's capacity, and every block the
+// level was ever asked for. LRU is a list threaded through the node arrays
+// (head most recent), found through an open addressed table of node + 1.
+typedef struct {
+    uint32_t capacity;
+    uint32_t count;
+    unsigned long int* blocks;
+    uint32_t* prev;
+    uint32_t* next;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t* table;
+    size_t table_size;
+
+    unsigned long int* seen;        // block + 1, 0 for an empty slot
+    size_t seen_size;
+    size_t seen_used;
+} ShadowCache;
+
+void shadow_init(ShadowCache* shadow, unsigned long int capacity);
+void shadow_reset(ShadowCache* shadow);
+void shadow_free(ShadowCache* shadow);
+void shadow_access(ShadowCache* shadow, unsigned long int block, MissClasses* classes, int hit);
+void add_miss_classes(MissClasses* total, const MissClasses* classes);
+
+#endif
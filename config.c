@@ -0,0 +1,344 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+
+#include "./cache_simulator.h"
+#include "./config.h"
+#include "./prefetch.h"
+#include "./replacement.h"
+#include "./timing.h"
+
+
+/**
+ * The hard coded hierarchy: 32KB direct mapped L1s, 256KB 4-way L2, no L3
+*/
+void default_config(CacheConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->block_size = BLOCK_SIZE;
+    config->l1i = (LevelConfig) { L1_INSTRUCTION_CACHE_SIZE, 1, POLICY_RANDOM, PREFETCH_NONE, DEFAULT_MSHRS };
+    config->l1d = (LevelConfig) { L1_DATA_CACHE_SIZE, 1, POLICY_RANDOM, PREFETCH_NONE, DEFAULT_MSHRS };
+    config->l2 = (LevelConfig) { L2_CACHE_SIZE, DEFAULT_ASSOCIATIVITY, POLICY_RANDOM, PREFETCH_NONE, DEFAULT_MSHRS };
+    config->l3 = (LevelConfig) { L3_CACHE_SIZE, L3_ASSOCIATIVITY, POLICY_RANDOM, PREFETCH_NONE, DEFAULT_MSHRS };
+    config->prefetch_degree = PREFETCH_DEGREE;
+    config->indexed_ways = DEFAULT_INDEXED_WAYS;
+}
+
+
+/**
+ * Parse a size, optionally suffixed with K, M or G (powers of 1024).
+ * Returns 0 on success, -1 on garbage.
+*/
+static int parse_size(const char* text, unsigned long int* size) {
+    char* end;
+    unsigned long int value = strtoul(text, &end, 10);
+    if (end == text) {
+        return -1;
+    }
+    switch (toupper((unsigned char) *end)) {
+    case 'K': value <<= 10; end++; break;
+    case 'M': value <<= 20; end++; break;
+    case 'G': value <<= 30; end++; break;
+    }
+    if (toupper((unsigned char) *end) == 'B') {
+        end++;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+    *size = value;
+    return 0;
+}
+
+
+/**
+ * Level named by the prefix of a key ("l1i", "l1d", "l2" or "l3")
+*/
+static LevelConfig* config_level(CacheConfig* config, const char* name, size_t length) {
+    static const char* const names[] = { "l1i", "l1d", "l2", "l3" };
+    LevelConfig* levels[] = { &config->l1i, &config->l1d, &config->l2, &config->l3 };
+    for (int i = 0; i < 4; i++) {
+        if (strlen(names[i]) == length && strncmp(name, names[i], length) == 0) {
+            return levels[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Set one key of a configuration.
+ * Keys: block-size, <level>-size, <level>-ways, <level>-policy with level
+ * l1i, l1d, l2 or l3, l1d-prefetch, l2-prefetch, prefetch-degree,
+ * <level>-mshrs, issue-window, indexed-ways, and the short forms a (l2-ways) and p
+ * (l2-policy).
+ * Returns 0 on success, -1 on an unknown key or bad value.
+*/
+int set_config_key(CacheConfig* config, const char* key, const char* value) {
+    if (strcmp(key, "a") == 0) {
+        key = "l2-ways";
+    } else if (strcmp(key, "p") == 0) {
+        key = "l2-policy";
+    }
+
+    if (strcmp(key, "block-size") == 0) {
+        return parse_size(value, &config->block_size);
+    }
+    if (strcmp(key, "prefetch-degree") == 0) {
+        char* end;
+        long int degree = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || degree < 1 || degree > MAX_PREFETCH_DEGREE) {
+            return -1;
+        }
+        config->prefetch_degree = degree;
+        return 0;
+    }
+    if (strcmp(key, "issue-window") == 0) {
+        char* end;
+        long int window = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || window < 0 || window > MAX_ISSUE_WINDOW) {
+            return -1;
+        }
+        config->issue_window = window;
+        return 0;
+    }
+    if (strcmp(key, "indexed-ways") == 0) {
+        char* end;
+        unsigned long int ways = strtoul(value, &end, 10);
+        if (end == value || *end != '\0' || value[0] == '-') {
+            return -1;
+        }
+        config->indexed_ways = ways;
+        return 0;
+    }
+
+    const char* field = strchr(key, '-');
+    LevelConfig* level = field ? config_level(config, key, field - key) : NULL;
+    if (level == NULL) {
+        return -1;
+    }
+    field++;
+
+    if (strcmp(field, "size") == 0) {
+        return parse_size(value, &level->size);
+    }
+    if (strcmp(field, "ways") == 0) {
+        char* end;
+        long int ways = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || ways <= 0) {
+            return -1;
+        }
+        level->associativity = ways;
+        return 0;
+    }
+    if (strcmp(field, "policy") == 0) {
+        level->policy = policy_parse(value);
+        return level->policy < 0 ? -1 : 0;
+    }
+    if (strcmp(field, "mshrs") == 0) {
+        char* end;
+        long int mshrs = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || mshrs < 1 || mshrs > MAX_MSHRS) {
+            return -1;
+        }
+        level->mshrs = mshrs;
+        return 0;
+    }
+    if (strcmp(field, "prefetch") == 0 && (level == &config->l1d || level == &config->l2)) {
+        level->prefetch = prefetch_parse(value);
+        return level->prefetch < 0 ? -1 : 0;
+    }
+    return -1;
+}
+
+
+/**
+ * Trim leading and trailing white space in place
+*/
+static char* trim(char* text) {
+    while (isspace((unsigned char) *text)) {
+        text++;
+    }
+    char* end = text + strlen(text);
+    while (end > text && isspace((unsigned char) end[-1])) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+
+/**
+ * Apply a settings file through set, one "key = value" per line, '#' starts a comment.
+ * Returns 0 on success, -1 (after printing why) if it can't be read or has a bad line.
+*/
+int load_settings_file(const char* path, SettingFunction set, void* target) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to open %s\n", path);
+        return -1;
+    }
+
+    char line[CONFIG_MAX_LINE];
+    int number = 0;
+    int status = 0;
+    while (status == 0 && fgets(line, sizeof(line), file)) {
+        number++;
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char* key = trim(line);
+        if (*key == '\0') {
+            continue;
+        }
+
+        char* value = strchr(key, '=');
+        if (value == NULL) {
+            status = -1;
+            break;
+        }
+        *value++ = '\0';
+        status = set(target, trim(key), trim(value));
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "Error: Invalid setting on line %d of %s\n", number, path);
+    }
+    fclose(file);
+    return status;
+}
+
+
+/**
+ * set_config_key for load_settings_file
+*/
+static int set_config_setting(void* config, const char* key, const char* value) {
+    return set_config_key(config, key, value);
+}
+
+
+/**
+ * Apply a config file of set_config_key settings
+*/
+int load_config_file(const char* path, CacheConfig* config) {
+    return load_settings_file(path, set_config_setting, config);
+}
+
+
+/**
+ * Sets of a level, 0 if the geometry doesn't divide evenly
+*/
+unsigned long int level_num_sets(const CacheConfig* config, const LevelConfig* level) {
+    unsigned long int set_bytes = config->block_size * level->associativity;
+    if (set_bytes == 0 || level->size % set_bytes != 0) {
+        return 0;
+    }
+    return level->size / set_bytes;
+}
+
+
+/**
+ * Whether a level is wide enough to keep a tag index and an LRU list
+*/
+int level_indexed(const CacheConfig* config, const LevelConfig* level) {
+    return level->associativity > config->indexed_ways;
+}
+
+
+/**
+ * Check one level's geometry and policy
+*/
+static int check_level(const CacheConfig* config, const LevelConfig* level, const char* name,
+                       char* error, size_t error_size) {
+    if (level_num_sets(config, level) == 0) {
+        snprintf(error, error_size, "%s size %lu isn't a whole number of %lu way sets of %lu B blocks",
+            name, level->size, level->associativity, config->block_size);
+        return -1;
+    }
+    if (policy_check(level->policy, level->associativity, level_indexed(config, level)) != 0) {
+        snprintf(error, error_size, "%s replacement policy %s can't run %lu ways",
+            name, policy_name(level->policy), level->associativity);
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Check a configuration can be simulated.
+ * Returns 0 if so, -1 with the reason in error if not.
+*/
+int check_config(const CacheConfig* config, char* error, size_t error_size) {
+    unsigned long int block = config->block_size;
+    if (block < sizeof(unsigned long int) || block > MAX_BLOCK_SIZE || (block & (block - 1)) != 0) {
+        snprintf(error, error_size, "block size %lu isn't a power of two from %zu to %d",
+            block, sizeof(unsigned long int), MAX_BLOCK_SIZE);
+        return -1;
+    }
+    if (check_level(config, &config->l1i, "L1 icache", error, error_size) != 0
+        || check_level(config, &config->l1d, "L1 dcache", error, error_size) != 0
+        || check_level(config, &config->l2, "L2", error, error_size) != 0) {
+        return -1;
+    }
+    if (config->l3.size && check_level(config, &config->l3, "L3", error, error_size) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Parse one configuration, key=value pairs (see set_config_key) separated by ':'.
+ * Returns 0 on success, -1 on an unknown key, bad value or impossible geometry.
+*/
+int parse_config(const char* spec, CacheConfig* config) {
+    char* copy = strdup(spec);
+    char* saveptr = NULL;
+    int status = 0;
+
+    for (char* pair = strtok_r(copy, ":", &saveptr); pair; pair = strtok_r(NULL, ":", &saveptr)) {
+        char* value = strchr(pair, '=');
+        if (value == NULL) {
+            status = -1;
+            break;
+        }
+        *value++ = '\0';
+
+        if (set_config_key(config, pair, value) != 0) {
+            status = -1;
+            break;
+        }
+    }
+
+    free(copy);
+
+    char error[CONFIG_MAX_LINE];
+    return status == 0 ? check_config(config, error, sizeof(error)) : status;
+}
+
+
+/**
+ * Parse a comma separated list of configurations.
+ * Every configuration starts from defaults.
+ * Returns the number parsed, -1 on a bad entry or more than max.
+*/
+int parse_config_list(const char* list, const CacheConfig* defaults, CacheConfig* configs, size_t max) {
+    char* specs = strdup(list);
+    char* saveptr = NULL;
+    int count = 0;
+
+    for (char* spec = strtok_r(specs, ",", &saveptr); spec; spec = strtok_r(NULL, ",", &saveptr)) {
+        if ((size_t) count == max) {
+            count = -1;
+            break;
+        }
+        configs[count] = *defaults;
+        if (parse_config(spec, &configs[count]) != 0) {
+            count = -1;
+            break;
+        }
+        count++;
+    }
+
+    free(specs);
+    return count;
+}
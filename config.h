@@ -0,0 +1,46 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stddef.h>
+
+// longest line of a config file
+#define CONFIG_MAX_LINE 256
+
+// geometry and policy of one cache level
+typedef struct {
+    unsigned long int size;             // bytes, 0 for an absent L3
+    unsigned long int associativity;
+    int policy;                         // replacement.h
+    int prefetch;                       // prefetch.h, L1 dcache and L2 only
+    int mshrs;                          // timing.h, with issue_window
+} LevelConfig;
+
+// one simulated configuration
+typedef struct {
+    unsigned long int block_size;
+    LevelConfig l1i;
+    LevelConfig l1d;
+    LevelConfig l2;
+    LevelConfig l3;
+    int tags_only;              // no payloads and no DRAM image
+    int prefetch_degree;        // blocks each prefetcher fetches ahead
+    int issue_window;           // accesses in flight in the non-blocking timing model, 0 for none
+    int classify;               // split each level's misses into the 3Cs (classify.h)
+    unsigned long int indexed_ways; // levels with more ways keep a tag index and an LRU list (cache_level.h)
+} CacheConfig;
+
+// applies one key = value setting to target, 0 on success
+typedef int (*SettingFunction)(void* target, const char* key, const char* value);
+
+int load_settings_file(const char* path, SettingFunction set, void* target);
+
+void default_config(CacheConfig* config);
+int set_config_key(CacheConfig* config, const char* key, const char* value);
+int load_config_file(const char* path, CacheConfig* config);
+int check_config(const CacheConfig* config, char* error, size_t error_size);
+int parse_config(const char* spec, CacheConfig* config);
+int parse_config_list(const char* list, const CacheConfig* defaults, CacheConfig* configs, size_t max);
+unsigned long int level_num_sets(const CacheConfig* config, const LevelConfig* level);
+int level_indexed(const CacheConfig* config, const LevelConfig* level);
+
+#endif
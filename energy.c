@@ -0,0 +1,221 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "./cache_simulator.h"
+#include "./energy.h"
+
+
+static const char* const PART_NAMES[NUM_PARTS] = { "l1i", "l1d", "l2", "l3", "dram" };
+
+
+/**
+ * The original energy constants
+*/
+void default_energy_model(EnergyModel* model) {
+    const double active[NUM_PARTS] = { L1_RW_ENERGY, L1_RW_ENERGY, L2_RW_ENERGY, L3_RW_ENERGY, DRAM_RW_ENERGY };
+    const double idle[NUM_PARTS] = { L1_IDLE_ENERGY, L1_IDLE_ENERGY, L2_IDLE_ENERGY, L3_IDLE_ENERGY, DRAM_IDLE_ENERGY };
+    for (int part = 0; part < NUM_PARTS; part++) {
+        model->active[part] = active[part];
+        model->idle[part] = idle[part];
+    }
+    model->l2_static_per_l1i_fill = L2_STATIC_PER_L1I_FILL;
+    model->dram_static_per_read = DRAM_STATIC_PER_READ;
+}
+
+
+/**
+ * Set one energy per event.
+ * Keys: <part>-active, <part>-idle with part l1i, l1d, l2, l3 or dram,
+ * l2-static-per-l1i-fill and dram-static-per-read.
+ * Returns 0 on success, -1 on an unknown key or bad value.
+*/
+int set_energy_key(EnergyModel* model, const char* key, const char* value) {
+    char* end;
+    double energy = strtod(value, &end);
+    if (end == value || *end != '\0') {
+        return -1;
+    }
+
+    if (strcmp(key, "l2-static-per-l1i-fill") == 0) {
+        model->l2_static_per_l1i_fill = energy;
+        return 0;
+    }
+    if (strcmp(key, "dram-static-per-read") == 0) {
+        model->dram_static_per_read = energy;
+        return 0;
+    }
+
+    const char* field = strchr(key, '-');
+    for (int part = 0; field && part < NUM_PARTS; part++) {
+        if (strlen(PART_NAMES[part]) != (size_t) (field - key) || strncmp(key, PART_NAMES[part], field - key) != 0) {
+            continue;
+        }
+        if (strcmp(field + 1, "active") == 0) {
+            model->active[part] = energy;
+            return 0;
+        }
+        if (strcmp(field + 1, "idle") == 0) {
+            model->idle[part] = energy;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * set_energy_key for load_settings_file
+*/
+static int set_energy_setting(void* model, const char* key, const char* value) {
+    return set_energy_key(model, key, value);
+}
+
+
+/**
+ * Apply an energy model file, "key = value" lines of set_energy_key settings
+*/
+int load_energy_model(const char* path, EnergyModel* model) {
+    return load_settings_file(path, set_energy_setting, model);
+}
+
+
+/**
+ * Price a run's counters.
+ * Every access to one part leaves every other present part idle for it.
+*/
+void compute_energy(const EnergyCounters* counters, int has_l3, const EnergyModel* model, EnergyTotals* totals) {
+    memset(totals, 0, sizeof(*totals));
+
+    for (int part = 0; part < NUM_PARTS; part++) {
+        if (part == PART_L3 && !has_l3) {
+            continue;
+        }
+        unsigned long int idle = counters->ticks - counters->active[part];
+        totals->dynamic_energy[part] = counters->active[part] * model->active[part] + idle * model->idle[part];
+    }
+    totals->static_energy[PART_L2] = counters->fills[PART_L1I] * model->l2_static_per_l1i_fill;
+    totals->static_energy[PART_DRAM] = counters->fills[PART_DRAM] * model->dram_static_per_read;
+
+    for (int part = 0; part < NUM_PARTS; part++) {
+        totals->total_dynamic += totals->dynamic_energy[part];
+        totals->total_static += totals->static_energy[part];
+    }
+}
+
+
+/**
+ * Column names of a counters CSV
+*/
+void write_energy_counters_header(FILE* file) {
+    fprintf(file, "config,has_l3,ticks");
+    for (int part = 0; part < NUM_PARTS; part++) {
+        fprintf(file, ",active_%s", PART_NAMES[part]);
+    }
+    for (int part = 0; part < NUM_PARTS; part++) {
+        fprintf(file, ",fills_%s", PART_NAMES[part]);
+    }
+    fprintf(file, "\n");
+}
+
+
+/**
+ * One counters CSV row
+*/
+void write_energy_counters(FILE* file, int index, int has_l3, const EnergyCounters* counters) {
+    fprintf(file, "%d,%d,%lu", index, has_l3, counters->ticks);
+    for (int part = 0; part < NUM_PARTS; part++) {
+        fprintf(file, ",%lu", counters->active[part]);
+    }
+    for (int part = 0; part < NUM_PARTS; part++) {
+        fprintf(file, ",%lu", counters->fills[part]);
+    }
+    fprintf(file, "\n");
+}
+
+
+/**
+ * Parse one counters CSV row, returns 0 on success
+*/
+static int read_energy_counters(const char* line, int* index, int* has_l3, EnergyCounters* counters) {
+    char* end;
+    unsigned long int fields[3 + 2 * NUM_PARTS];
+    for (int i = 0; i < 3 + 2 * NUM_PARTS; i++) {
+        fields[i] = strtoul(line, &end, 10);
+        if (end == line || (*end != ',' && i < 2 + 2 * NUM_PARTS)) {
+            return -1;
+        }
+        line = end + 1;
+    }
+
+    *index = fields[0];
+    *has_l3 = fields[1];
+    counters->ticks = fields[2];
+    for (int part = 0; part < NUM_PARTS; part++) {
+        counters->active[part] = fields[3 + part];
+        counters->fills[part] = fields[3 + NUM_PARTS + part];
+    }
+    return 0;
+}
+
+
+/**
+ * cache_simulator energy <counters.csv> <--energy=model>
+ * Prices the counters saved with --counters under another energy model.
+*/
+int energy_main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s energy <counters.csv> <--energy=model>\n", argv[0]);
+        return 1;
+    }
+
+    EnergyModel model;
+    default_energy_model(&model);
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], "--energy=", 9) == 0) {
+            if (load_energy_model(argv[i] + 9, &model) != 0) {
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(argv[2], "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to open %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("Config | Total Dynamic Energy (W) | Total Static Energy (pJ) |");
+    for (int part = 0; part < NUM_PARTS; part++) {
+        printf(" %-4s Dynamic | %-4s Static |", PART_NAMES[part], PART_NAMES[part]);
+    }
+    printf("\n");
+
+    char line[CONFIG_MAX_LINE * 2];
+    int number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (++number == 1) {
+            continue;   // header
+        }
+
+        int index, has_l3;
+        EnergyCounters counters;
+        if (read_energy_counters(line, &index, &has_l3, &counters) != 0) {
+            fprintf(stderr, "Error: Malformed counters on line %d of %s\n", number, argv[2]);
+            fclose(file);
+            return 1;
+        }
+
+        EnergyTotals totals;
+        compute_energy(&counters, has_l3, &model, &totals);
+        printf("%-6d | %-24f | %-24f |", index, totals.total_dynamic, totals.total_static);
+        for (int part = 0; part < NUM_PARTS; part++) {
+            printf(" %-12.2f | %-11.2f |", totals.dynamic_energy[part], totals.static_energy[part]);
+        }
+        printf("\n");
+    }
+
+    fclose(file);
+    return 0;
+}
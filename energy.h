@@ -0,0 +1,46 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdio.h>
+
+// parts of the hierarchy energy is charged to
+#define PART_L1I  0
+#define PART_L1D  1
+#define PART_L2   2
+#define PART_L3   3
+#define PART_DRAM 4
+#define NUM_PARTS 5
+
+// event counts of one run, priced by an EnergyModel afterwards
+typedef struct {
+    unsigned long int ticks;                // accesses to any part
+    unsigned long int active[NUM_PARTS];    // accesses to each part, the others idle meanwhile
+    unsigned long int fills[NUM_PARTS];     // blocks read into each part, DRAM: blocks read out
+} EnergyCounters;
+
+// energy per event
+typedef struct {
+    double active[NUM_PARTS];       // per access to the part
+    double idle[NUM_PARTS];         // per access to another part
+    double l2_static_per_l1i_fill;  // L2 static energy per L1 icache fill
+    double dram_static_per_read;    // DRAM static energy per block read
+} EnergyModel;
+
+// priced counters
+typedef struct {
+    double dynamic_energy[NUM_PARTS];
+    double static_energy[NUM_PARTS];
+    double total_dynamic;
+    double total_static;
+} EnergyTotals;
+
+void default_energy_model(EnergyModel* model);
+int set_energy_key(EnergyModel* model, const char* key, const char* value);
+int load_energy_model(const char* path, EnergyModel* model);
+void compute_energy(const EnergyCounters* counters, int has_l3, const EnergyModel* model, EnergyTotals* totals);
+
+void write_energy_counters_header(FILE* file);
+void write_energy_counters(FILE* file, int index, int has_l3, const EnergyCounters* counters);
+int energy_main(int argc, char* argv[]);
+
+#endif
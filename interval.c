@@ -0,0 +1,298 @@
+#define _DEFAULT_SOURCE
+
+#include <math.h>
+
+#include "./interval.h"
+
+
+/**
+ * Parse --interval=count[ns]:file, count trace records or ns of simulation_clock.
+ * Returns 0 on success, -1 on garbage.
+*/
+int parse_interval(const char* spec, IntervalConfig* interval) {
+    memset(interval, 0, sizeof(*interval));
+
+    char* end;
+    double ns = strtod(spec, &end);
+    if (end != spec && strncmp(end, "ns", 2) == 0) {
+        if (!(ns > 0)) {
+            return -1;
+        }
+        interval->unit = INTERVAL_NS;
+        interval->ns = ns;
+        end += 2;
+    } else {
+        interval->unit = INTERVAL_RECORDS;
+        interval->records = strtoul(spec, &end, 10);
+        if (end == spec || interval->records == 0) {
+            return -1;
+        }
+    }
+
+    if (*end != ':' || end[1] == '\0') {
+        return -1;
+    }
+    interval->filename = end + 1;
+    return 0;
+}
+
+
+/**
+ * One CSV row: what a configuration did since its previous snapshot
+*/
+static void write_row(IntervalWriter* writer, const IntervalSnapshot* snapshot) {
+    IntervalSnapshot* last = &writer->last[snapshot->config];
+    const CacheStats* now = &snapshot->stats;
+    const CacheStats* then = &last->stats;
+
+    EnergyCounters energy;
+    energy.ticks = now->energy.ticks - then->energy.ticks;
+    for (int part = 0; part < NUM_PARTS; part++) {
+        energy.active[part] = now->energy.active[part] - then->energy.active[part];
+        energy.fills[part] = now->energy.fills[part] - then->energy.fills[part];
+    }
+
+    // pricing is linear in the counts, so priced deltas are energy deltas
+    EnergyTotals totals;
+    compute_energy(&energy, writer->has_l3[snapshot->config], writer->model, &totals);
+
+    fprintf(writer->file, "%d,%lu,%lu,%.2f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.2f,%.2f,%.2f",
+        snapshot->config, writer->intervals[snapshot->config]++, snapshot->records, now->simulation_clock,
+        snapshot->records - last->records,
+        now->l1_icache_hits - then->l1_icache_hits, now->l1_icache_misses - then->l1_icache_misses,
+        now->l1_dcache_hits - then->l1_dcache_hits, now->l1_dcache_misses - then->l1_dcache_misses,
+        now->l2_hits - then->l2_hits, now->l2_misses - then->l2_misses,
+        now->l3_hits - then->l3_hits, now->l3_misses - then->l3_misses,
+        now->dram_hits - then->dram_hits,
+        now->simulation_clock - then->simulation_clock, totals.total_dynamic, totals.total_static);
+    for (int part = 0; part < NUM_PARTS; part++) {
+        fprintf(writer->file, ",%.2f", totals.dynamic_energy[part] + totals.static_energy[part]);
+    }
+    fprintf(writer->file, "\n");
+
+    *last = *snapshot;
+}
+
+
+/**
+ * Writer thread: format every buffer the simulation hands over
+*/
+static void* writer_main(void* arg) {
+    IntervalWriter* writer = arg;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (writer->handed == 0 && !writer->done) {
+            pthread_cond_wait(&writer->cond, &writer->lock);
+        }
+        if (writer->handed == 0) {
+            break;
+        }
+        const IntervalSnapshot* buffer = writer->buffers[!writer->filling];
+        size_t count = writer->handed;
+        pthread_mutex_unlock(&writer->lock);
+
+        for (size_t i = 0; i < count; i++) {
+            write_row(writer, &buffer[i]);
+        }
+        if (ferror(writer->file)) {
+            writer->failed = 1;
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        writer->handed = 0;
+        pthread_cond_signal(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+
+/**
+ * Create the CSV and start its writer thread.
+ * Returns 0 on success, -1 if the file can't be created.
+*/
+int interval_writer_open(IntervalWriter* writer, const char* filename, CacheSim** sims, size_t num_sims,
+                         const EnergyModel* model) {
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(filename, "w");
+    if (writer->file == NULL) {
+        return -1;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, 1 << 20);
+    fprintf(writer->file, "config,interval,records,clock,interval_records,"
+        "l1i_hits,l1i_misses,l1d_hits,l1d_misses,l2_hits,l2_misses,l3_hits,l3_misses,dram_accesses,"
+        "access_time,dynamic_energy,static_energy,energy_l1i,energy_l1d,energy_l2,energy_l3,energy_dram\n");
+
+    writer->model = model;
+    writer->num_sims = num_sims;
+    for (size_t i = 0; i < num_sims; i++) {
+        writer->has_l3[i] = sims[i]->has_l3;
+    }
+
+    for (int b = 0; b < 2; b++) {
+        writer->buffers[b] = malloc(INTERVAL_BUFFER_SIZE * sizeof(IntervalSnapshot));
+        if (!writer->buffers[b]) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+    }
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        fprintf(stderr, "Error: Unable to start the interval writer thread\n");
+        exit(1);
+    }
+    return 0;
+}
+
+
+/**
+ * Hand the filled buffer to the writer, waiting if it's still on the last one
+*/
+static void hand_over(IntervalWriter* writer) {
+    pthread_mutex_lock(&writer->lock);
+    while (writer->handed != 0) {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    writer->handed = writer->count;
+    writer->filling = !writer->filling;
+    writer->count = 0;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+
+/**
+ * Queue a configuration's stats at the end of an interval
+*/
+void interval_snapshot(IntervalWriter* writer, int config, unsigned long int records, const CacheStats* stats) {
+    IntervalSnapshot* snapshot = &writer->buffers[writer->filling][writer->count++];
+    snapshot->config = config;
+    snapshot->records = records;
+    snapshot->stats = *stats;
+    if (writer->count == INTERVAL_BUFFER_SIZE) {
+        hand_over(writer);
+    }
+}
+
+
+/**
+ * Write what's queued, stop the writer thread and close the CSV.
+ * Returns 0 on success, -1 on a write error.
+*/
+int interval_writer_close(IntervalWriter* writer) {
+    if (writer->count > 0) {
+        hand_over(writer);
+    }
+    pthread_mutex_lock(&writer->lock);
+    writer->done = 1;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    int status = writer->failed ? -1 : 0;
+    if (fclose(writer->file) != 0) {
+        status = -1;
+    }
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    return status;
+}
+
+
+/**
+ * Run a trace through every simulator, snapshotting each one's stats at
+ * the end of every interval. Record intervals end on batch boundaries, so
+ * they cost nothing per record; ns intervals compare the clock after each
+ * record. The last, partial interval is snapshotted too.
+*/
+RunResult run_interval_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                             const IntervalConfig* interval, IntervalWriter* writer) {
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+
+    TraceReader reader;
+    if (trace_open(&reader, filename, reader_kind) != 0) {
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+
+    TraceRecord* batch = malloc(SWEEP_BATCH_SIZE * sizeof(TraceRecord));
+    if (!batch) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    unsigned long int snapped[MAX_SWEEP_CONFIGS];
+    double next_ns[MAX_SWEEP_CONFIGS];
+    for (size_t i = 0; i < num_sims; i++) {
+        snapped[i] = 0;
+        next_ns[i] = interval->ns;
+    }
+
+    int status = TRACE_RECORD;
+    while (status == TRACE_RECORD && result.status == RUN_OK) {
+        size_t wanted = SWEEP_BATCH_SIZE;
+        if (interval->unit == INTERVAL_RECORDS) {
+            unsigned long int left = interval->records - result.records % interval->records;
+            if (left < wanted) {
+                wanted = left;
+            }
+        }
+
+        size_t count = 0;
+        while (count < wanted && (status = trace_next(&reader, &batch[count])) == TRACE_RECORD) {
+            count++;
+        }
+
+        for (size_t i = 0; i < num_sims && result.status == RUN_OK; i++) {
+            CacheSim* sim = sims[i];
+            // record intervals end on a batch boundary, so the batch can be coalesced
+            if (interval->unit == INTERVAL_RECORDS) {
+                size_t done = simulate_records(sim, batch, count);
+                if (done < count) {
+                    result.status = RUN_INVALID_OP;
+                    result.record = batch[done];
+                }
+                continue;
+            }
+            for (size_t j = 0; j < count; j++) {
+                if (simulate_record(sim, &batch[j]) != 0) {
+                    result.status = RUN_INVALID_OP;
+                    result.record = batch[j];
+                    break;
+                }
+                if (sim->stats.simulation_clock >= next_ns[i]) {
+                    snapped[i] = result.records + j + 1;
+                    interval_snapshot(writer, i, snapped[i], &sim->stats);
+                    next_ns[i] = (floor(sim->stats.simulation_clock / interval->ns) + 1) * interval->ns;
+                }
+            }
+        }
+        result.records += count;
+
+        if (interval->unit == INTERVAL_RECORDS && count > 0 && result.records % interval->records == 0) {
+            for (size_t i = 0; i < num_sims; i++) {
+                snapped[i] = result.records;
+                interval_snapshot(writer, i, snapped[i], &sims[i]->stats);
+            }
+        }
+    }
+
+    if (result.status == RUN_OK && status == TRACE_MALFORMED) {
+        result.status = RUN_MALFORMED;
+        result.line = reader.line;
+    }
+    for (size_t i = 0; i < num_sims && result.status == RUN_OK; i++) {
+        if (snapped[i] < result.records) {
+            interval_snapshot(writer, i, result.records, &sims[i]->stats);
+        }
+    }
+
+    free(batch);
+    trace_close(&reader);
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <pthread.h>
+
+#include "./cache_simulator.h"
+
+// what an interval is counted in
+#define INTERVAL_RECORDS 0
+#define INTERVAL_NS      1
+
+// snapshots the simulation fills before handing them to the writer thread
+#define INTERVAL_BUFFER_SIZE 1024
+
+// what --interval asked for
+typedef struct {
+    int unit;
+    unsigned long int records;      // INTERVAL_RECORDS: trace records per interval
+    double ns;                      // INTERVAL_NS: simulation_clock per interval
+    const char* filename;           // CSV to write
+} IntervalConfig;
+
+// a simulator's stats at the end of an interval
+typedef struct {
+    int config;
+    unsigned long int records;      // trace records simulated so far
+    CacheStats stats;
+} IntervalSnapshot;
+
+// background CSV writer, the simulation only copies stats into its buffers
+typedef struct {
+    FILE* file;
+    const EnergyModel* model;
+    size_t num_sims;
+    int has_l3[MAX_SWEEP_CONFIGS];
+
+    // previous snapshot of each configuration, deltas are taken against it
+    IntervalSnapshot last[MAX_SWEEP_CONFIGS];
+    unsigned long int intervals[MAX_SWEEP_CONFIGS];
+
+    // the simulation fills one buffer while the writer drains the other
+    IntervalSnapshot* buffers[2];
+    int filling;                    // buffer the simulation fills
+    size_t count;                   // snapshots in it
+    size_t handed;                  // snapshots in the other one, 0 once written
+    int done;
+    int failed;                     // a write failed
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} IntervalWriter;
+
+int parse_interval(const char* spec, IntervalConfig* interval);
+int interval_writer_open(IntervalWriter* writer, const char* filename, CacheSim** sims, size_t num_sims,
+                         const EnergyModel* model);
+void interval_snapshot(IntervalWriter* writer, int config, unsigned long int records, const CacheStats* stats);
+int interval_writer_close(IntervalWriter* writer);
+RunResult run_interval_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                             const IntervalConfig* interval, IntervalWriter* writer);
+
+#endif
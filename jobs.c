@@ -0,0 +1,330 @@
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "./jobs.h"
+#include "./wall_clock.h"
+
+
+// per-worker queue of job indices
+// the owner takes from the tail, idle workers steal from the head
+typedef struct {
+    pthread_mutex_t lock;
+    size_t* items;
+    size_t head;
+    size_t tail;
+} JobDeque;
+
+// shared state of one run_jobs call
+typedef struct {
+    Job* jobs;
+    JobDeque* deques;
+    int num_workers;
+    int reader_kind;
+} JobPool;
+
+typedef struct {
+    JobPool* pool;
+    int id;
+} Worker;
+
+
+/**
+ * Take the newest job from our own deque
+*/
+static int pop_job(JobDeque* deque, size_t* job) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail > deque->head) {
+        *job = deque->items[--deque->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+
+/**
+ * Take the oldest job from someone else's deque
+*/
+static int steal_job(JobDeque* deque, size_t* job) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail > deque->head) {
+        *job = deque->items[deque->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+
+/**
+ * Find the next job for a worker, stealing once its own deque is empty.
+ * No job creates new jobs, so finding nothing anywhere means we're done.
+*/
+static int next_job(Worker* worker, size_t* job) {
+    JobPool* pool = worker->pool;
+    if (pop_job(&pool->deques[worker->id], job)) {
+        return 1;
+    }
+    for (int i = 1; i < pool->num_workers; i++) {
+        int victim = (worker->id + i) % pool->num_workers;
+        if (steal_job(&pool->deques[victim], job)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Run one job on a fresh simulator
+*/
+static void run_job(JobPool* pool, Job* job, int worker) {
+    double start = now_seconds();
+
+    CacheSim* sim = create_simulator(&job->config);
+    job->result = run_dinero_trace(job->trace, pool->reader_kind, &sim, 1);
+    job->stats = sim->stats;
+    destroy_simulator(sim);
+
+    job->seconds = now_seconds() - start;
+    job->worker = worker;
+}
+
+
+/**
+ * Worker thread
+*/
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    size_t job;
+    while (next_job(worker, &job)) {
+        run_job(worker->pool, &worker->pool->jobs[job], worker->id);
+    }
+    return NULL;
+}
+
+
+/**
+ * Run every job on num_threads workers.
+ * Jobs are dealt round robin, idle workers steal from busy ones.
+ * If a thread can't be started the others (or the caller) pick up its jobs.
+ * Returns the workers used, num_threads clamped to 1..num_jobs.
+*/
+int run_jobs(Job* jobs, size_t num_jobs, int reader_kind, int num_threads) {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    if ((size_t) num_threads > num_jobs) {
+        num_threads = num_jobs ? num_jobs : 1;
+    }
+
+    JobPool pool = { .jobs = jobs, .num_workers = num_threads, .reader_kind = reader_kind };
+    pool.deques = calloc(num_threads, sizeof(JobDeque));
+    Worker* workers = calloc(num_threads, sizeof(Worker));
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    if (!pool.deques || !workers || !threads) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].items = malloc((num_jobs / num_threads + 1) * sizeof(size_t));
+        if (!pool.deques[i].items) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+
+    // reversed so each owner pops its jobs in submission order
+    for (size_t j = num_jobs; j-- > 0;) {
+        JobDeque* deque = &pool.deques[j % num_threads];
+        deque->items[deque->tail++] = j;
+    }
+
+    int started = 0;
+    for (; started < num_threads; started++) {
+        if (pthread_create(&threads[started], NULL, worker_main, &workers[started]) != 0) {
+            break;
+        }
+    }
+    // whatever did start still drains every deque
+    if (started == 0) {
+        worker_main(&workers[0]);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+        free(pool.deques[i].items);
+    }
+    free(pool.deques);
+    free(workers);
+    free(threads);
+    return num_threads;
+}
+
+
+/**
+ * Name of a RunResult status for the report
+*/
+static const char* status_name(int status) {
+    switch (status) {
+    case RUN_OK:          return "ok";
+    case RUN_OPEN_FAILED: return "open_failed";
+    case RUN_MALFORMED:   return "malformed";
+    case RUN_INVALID_OP:  return "invalid_op";
+    }
+    return "unknown";
+}
+
+
+/**
+ * Write every job as one CSV row
+*/
+void write_job_report(FILE* file, const Job* jobs, size_t num_jobs, const EnergyModel* model) {
+    fprintf(file, "trace,associativity,policy,l2_size,l3_size,status,records,seconds,worker,"
+        "total_access_time,dynamic_energy,static_energy,"
+        "l1i_hits,l1i_misses,l1d_hits,l1d_misses,l2_hits,l2_misses,l3_hits,l3_misses,dram_hits\n");
+
+    for (size_t i = 0; i < num_jobs; i++) {
+        const Job* job = &jobs[i];
+        const CacheStats* stats = &job->stats;
+        EnergyTotals energy;
+        compute_energy(&stats->energy, job->config.l3.size != 0, model, &energy);
+        fprintf(file, "%s,%lu,%s,%lu,%lu,%s,%lu,%.6f,%d,%.2f,%f,%f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+            job->trace, job->config.l2.associativity, policy_name(job->config.l2.policy),
+            job->config.l2.size, job->config.l3.size, status_name(job->result.status),
+            job->result.records, job->seconds, job->worker,
+            stats->simulation_clock, energy.total_dynamic, energy.total_static,
+            stats->l1_icache_hits, stats->l1_icache_misses,
+            stats->l1_dcache_hits, stats->l1_dcache_misses,
+            stats->l2_hits, stats->l2_misses, stats->l3_hits, stats->l3_misses, stats->dram_hits);
+    }
+}
+
+
+/**
+ * cache_simulator jobs <-j threads> <--config=file> <--energy=model> <--configs=...> <--report=file.csv> <--reader=...> <--tags-only> trace ...
+*/
+int jobs_main(int argc, char* argv[]) {
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int reader_kind = READER_MMAP;
+    const char* report = NULL;
+    const char* configs_spec = NULL;
+    CacheConfig defaults;
+    default_config(&defaults);
+    EnergyModel model;
+    default_energy_model(&model);
+
+    const char* traces[MAX_JOB_TRACES];
+    size_t num_traces = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "--configs=", 10) == 0) {
+            configs_spec = argv[i] + 10;
+        } else if (strcmp(argv[i], "--tags-only") == 0) {
+            defaults.tags_only = 1;
+        } else if (strncmp(argv[i], "--energy=", 9) == 0) {
+            if (load_energy_model(argv[i] + 9, &model) != 0) {
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--config=", 9) == 0) {
+            if (load_config_file(argv[i] + 9, &defaults) != 0) {
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--report=", 9) == 0) {
+            report = argv[i] + 9;
+        } else if (strncmp(argv[i], "--reader=", 9) == 0) {
+            reader_kind = trace_parse_reader(argv[i] + 9);
+            if (reader_kind < 0) {
+                fprintf(stderr, "Invalid reader, expected stdio or mmap\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0 && strchr(argv[i], '=')) {
+            const char* value = strchr(argv[i], '=') + 1;
+            char key[CONFIG_MAX_LINE];
+            snprintf(key, sizeof(key), "%.*s", (int) (value - argv[i] - 3), argv[i] + 2);
+            if (set_config_key(&defaults, key, value) != 0) {
+                fprintf(stderr, "Invalid option %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Invalid option %s\n", argv[i]);
+            return 1;
+        } else if (num_traces < MAX_JOB_TRACES) {
+            traces[num_traces++] = argv[i];
+        } else {
+            fprintf(stderr, "Too many traces, at most %d\n", MAX_JOB_TRACES);
+            return 1;
+        }
+    }
+
+    if (num_traces == 0) {
+        fprintf(stderr, "Usage: %s jobs <-j threads> <--config=file> <--energy=model> <--configs=a=2:p=lru,a=4,...> <--report=file.csv> <--tags-only> <--LEVEL-size=S> ... <trace_file.din> ...\n", argv[0]);
+        return 1;
+    }
+
+    char error[CONFIG_MAX_LINE];
+    if (check_config(&defaults, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Invalid configuration: %s\n", error);
+        return 1;
+    }
+    CacheConfig configs[MAX_JOB_CONFIGS] = { defaults };
+    size_t num_configs = 1;
+    if (configs_spec) {
+        int parsed = parse_config_list(configs_spec, &defaults, configs, MAX_JOB_CONFIGS);
+        if (parsed <= 0) {
+            fprintf(stderr, "Invalid configurations: %s\n", configs_spec);
+            return 1;
+        }
+        num_configs = parsed;
+    }
+
+    size_t num_jobs = num_traces * num_configs;
+    Job* jobs = calloc(num_jobs, sizeof(Job));
+    if (!jobs) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    for (size_t t = 0; t < num_traces; t++) {
+        for (size_t c = 0; c < num_configs; c++) {
+            jobs[t * num_configs + c].trace = traces[t];
+            jobs[t * num_configs + c].config = configs[c];
+        }
+    }
+
+    double start = now_seconds();
+    num_threads = run_jobs(jobs, num_jobs, reader_kind, num_threads);
+    double elapsed = now_seconds() - start;
+
+    FILE* file = report ? fopen(report, "w") : stdout;
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to create %s\n", report);
+        return 1;
+    }
+    write_job_report(file, jobs, num_jobs, &model);
+    if (report) {
+        fclose(file);
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < num_jobs; i++) {
+        failed += jobs[i].result.status != RUN_OK;
+    }
+    fprintf(stderr, "Ran %zu jobs on %d threads in %.2f s, %d failed\n",
+        num_jobs, num_threads, elapsed, failed);
+
+    free(jobs);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "./cache_simulator.h"
+
+// most traces / configurations on one jobs command line
+#define MAX_JOB_TRACES 1024
+#define MAX_JOB_CONFIGS MAX_SWEEP_CONFIGS
+
+// one trace x configuration simulation
+typedef struct {
+    const char* trace;
+    CacheConfig config;
+
+    // filled in by the worker that ran it
+    RunResult result;
+    CacheStats stats;
+    double seconds;
+    int worker;
+} Job;
+
+int run_jobs(Job* jobs, size_t num_jobs, int reader_kind, int num_threads);
+void write_job_report(FILE* file, const Job* jobs, size_t num_jobs, const EnergyModel* model);
+int jobs_main(int argc, char* argv[]);
+
+#endif
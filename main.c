@@ -0,0 +1,665 @@
+#define _DEFAULT_SOURCE
+
+#include "./cache_simulator.h"
+#include "./checkpoint.h"
+#include "./interval.h"
+#include "./jobs.h"
+#include "./miss_stream.h"
+#include "./multicore.h"
+#include "./partition.h"
+#include "./pipeline.h"
+#include "./profile.h"
+#include "./sampling.h"
+#include "./stack_distance.h"
+#include "./trace.h"
+
+
+// trace reader backend, set with --reader
+int TRACE_READER = READER_MMAP;
+
+// decode on a reader thread ahead of the simulation, set with --pipeline
+int PIPELINE = 0;
+
+// worker threads splitting the sets between them, set with --partitions
+int PARTITIONS = 1;
+
+// L1 miss stream to write, set with --capture
+const char* CAPTURE = NULL;
+
+// the trace is a captured L1 miss stream, set with --replay
+int REPLAY = 0;
+MissStreamInfo REPLAY_INFO;
+
+// sampling plan, set with --sample or --set-sample, and what it measured
+SampleConfig SAMPLE;
+Samples SAMPLES[MAX_SWEEP_CONFIGS];
+
+// state to save or resume from, set with --checkpoint and --restore
+CheckpointPlan CHECKPOINT;
+CheckpointMark RESTORED;
+
+// stats time series, set with --interval
+IntervalConfig INTERVAL;
+IntervalWriter INTERVAL_WRITER;
+
+// prices the energy counters in print_stats, set with --energy
+EnergyModel ENERGY_MODEL;
+
+// time the hot path stages, set with --profile (in a make PROFILE=1 build)
+int PROFILING = 0;
+
+// function declarations
+void print_title();
+void print_stats(CacheSim* sim);
+void process_trace_file(const char* filename);
+void process_dinero_trace(const char* filename, CacheSim** sims, size_t num_sims);
+void convert_dinero_trace(const char* input, const char* output);
+
+
+
+/**************************************
+ * Main entry point
+***************************************/
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace_file.din> <-n> <-a> <associativity> <-p> <policy> <--reader=stdio|mmap> <--pipeline> <--partitions=N> <--capture=l1.dinb> <--replay> <--checkpoint=records:file> <--restore=file> <--interval=N[ns]:file.csv> <--sweep=a=2,a=4,...> <--LEVEL-prefetch=none|next-line|stride|stream> <--prefetch-degree=N> <--issue-window=N> <--LEVEL-mshrs=N> <--indexed-ways=N> <--classify-misses> <--tags-only> <--profile>\n", argv[0]);
+        fprintf(stderr, "       %*s <--sample=period:window[:warmup]> <--set-sample=partitions:sampled>\n", (int) strlen(argv[0]), "");
+        fprintf(stderr, "       %*s <--config=file> <--block-size=B> <--LEVEL-size=S> <--LEVEL-ways=W> <--LEVEL-policy=P>\n", (int) strlen(argv[0]), "");
+        fprintf(stderr, "       %*s LEVEL: l1i|l1d|l2|l3   P: random|lru|plru|srrip|brrip|xorshift\n", (int) strlen(argv[0]), "");
+        fprintf(stderr, "       %*s <--energy=model> <--counters=counters.csv>\n", (int) strlen(argv[0]), "");
+        fprintf(stderr, "       %s convert <trace_file.din> <trace_file.dinb>\n", argv[0]);
+        fprintf(stderr, "       %s energy <counters.csv> <--energy=model>\n", argv[0]);
+        fprintf(stderr, "       %s jobs <-j threads> <--configs=a=2:p=lru,a=4,...> <--report=file.csv> <--tags-only> <--LEVEL-size=S> ... <trace_file.din> ...\n", argv[0]);
+        fprintf(stderr, "       %s mrc <trace_file.din> <--stream=unified|instruction|data> <--block-size=B>\n", argv[0]);
+        fprintf(stderr, "       %s multicore <-j threads> <--epoch=ns> <--config=file> <--LEVEL-size=S> ... <core0.din> <core1.din> ...\n", argv[0]);
+        return 1;
+    }
+
+    // one pass miss ratio curves
+    if (strcmp(argv[1], "mrc") == 0) {
+        return mrc_main(argc, argv);
+    }
+
+    // price saved energy counters under another model
+    if (strcmp(argv[1], "energy") == 0) {
+        return energy_main(argc, argv);
+    }
+
+    // one trace per core, private L1s kept coherent over a shared L2
+    if (strcmp(argv[1], "multicore") == 0) {
+        return multicore_main(argc, argv);
+    }
+
+    // trace x configuration jobs on a thread pool
+    if (strcmp(argv[1], "jobs") == 0) {
+        return jobs_main(argc, argv);
+    }
+
+    // din to binary trace conversion
+    if (strcmp(argv[1], "convert") == 0) {
+        if (argc != 4) {
+            fprintf(stderr, "Usage: %s convert <trace_file.din> <trace_file.dinb>\n", argv[0]);
+            return 1;
+        }
+        convert_dinero_trace(argv[2], argv[3]);
+        return 0;
+    }
+
+    if (argc == 2) {
+        print_title();
+    }
+
+    // Initialize caches
+    CacheConfig defaults;
+    default_config(&defaults);
+    default_energy_model(&ENERGY_MODEL);
+    const char* sweep = NULL;
+    const char* counters = NULL;
+    int partitioned = 0;
+
+    for (int i = 2; i < argc; i++) {
+        // set associativity
+        if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            if (set_config_key(&defaults, "a", argv[++i]) != 0) {
+                fprintf(stderr, "Invalid associativity\n");
+                exit(1);
+            }
+        }
+        // set the L2 replacement policy
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            if (set_config_key(&defaults, "p", argv[++i]) != 0) {
+                fprintf(stderr, "Invalid policy\n");
+                exit(1);
+            }
+        }
+        // trace reader backend
+        else if (strncmp(argv[i], "--reader=", 9) == 0) {
+            TRACE_READER = trace_parse_reader(argv[i] + 9);
+            if (TRACE_READER < 0) {
+                fprintf(stderr, "Invalid reader, expected stdio or mmap\n");
+                exit(1);
+            }
+        }
+        // reader thread feeding the simulation through a ring
+        else if (strcmp(argv[i], "--pipeline") == 0) {
+            PIPELINE = 1;
+        }
+        // sets split across worker threads
+        else if (strncmp(argv[i], "--partitions=", 13) == 0) {
+            char* end;
+            long partitions = strtol(argv[i] + 13, &end, 10);
+            if (end == argv[i] + 13 || *end != '\0' || partitions < 1 || partitions > MAX_PARTITIONS) {
+                fprintf(stderr, "Invalid partitions: %s\n", argv[i] + 13);
+                exit(1);
+            }
+            PARTITIONS = partitions;
+            partitioned = 1;
+        }
+        // record what the L1s send the L2 instead of simulating the L2
+        else if (strncmp(argv[i], "--capture=", 10) == 0) {
+            CAPTURE = argv[i] + 10;
+        }
+        // run a captured L1 miss stream into the L2s
+        else if (strcmp(argv[i], "--replay") == 0) {
+            REPLAY = 1;
+        }
+        // save the state after some records and stop
+        else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            if (parse_checkpoint(argv[i] + 13, &CHECKPOINT) != 0 || CHECKPOINT.save_at == 0) {
+                fprintf(stderr, "Invalid checkpoint, expected records:file\n");
+                exit(1);
+            }
+        }
+        // resume from a saved state
+        else if (strncmp(argv[i], "--restore=", 10) == 0) {
+            CHECKPOINT.restore = argv[i] + 10;
+        }
+        // stats every N records or ns
+        else if (strncmp(argv[i], "--interval=", 11) == 0) {
+            if (parse_interval(argv[i] + 11, &INTERVAL) != 0) {
+                fprintf(stderr, "Invalid interval, expected records:file or <ns>ns:file, e.g. 100000:phases.csv or 1e6ns:phases.csv\n");
+                exit(1);
+            }
+        }
+        // periodic detailed windows
+        else if (strncmp(argv[i], "--sample=", 9) == 0) {
+            if (parse_sample(argv[i] + 9, SAMPLE_WINDOWS, &SAMPLE) != 0) {
+                fprintf(stderr, "Invalid sample, expected period:window[:warmup]\n");
+                exit(1);
+            }
+        }
+        // a few set partitions
+        else if (strncmp(argv[i], "--set-sample=", 13) == 0) {
+            if (parse_sample(argv[i] + 13, SAMPLE_SETS, &SAMPLE) != 0) {
+                fprintf(stderr, "Invalid set sample, expected partitions:sampled\n");
+                exit(1);
+            }
+        }
+        // several configurations over one pass of the trace
+        else if (strncmp(argv[i], "--sweep=", 8) == 0) {
+            sweep = argv[i] + 8;
+        }
+        // keep only tags and state bits, no payloads or DRAM image
+        else if (strcmp(argv[i], "--tags-only") == 0) {
+            defaults.tags_only = 1;
+        }
+        // split each level's misses into compulsory, capacity and conflict
+        else if (strcmp(argv[i], "--classify-misses") == 0) {
+            defaults.classify = 1;
+        }
+        // per stage time of the run
+        else if (strcmp(argv[i], "--profile") == 0) {
+            PROFILING = 1;
+        }
+        // energy per event, "key = value" lines
+        else if (strncmp(argv[i], "--energy=", 9) == 0) {
+            if (load_energy_model(argv[i] + 9, &ENERGY_MODEL) != 0) {
+                exit(1);
+            }
+        }
+        // save the energy counters to price them again later
+        else if (strncmp(argv[i], "--counters=", 11) == 0) {
+            counters = argv[i] + 11;
+        }
+        // hierarchy from a config file, later flags override it
+        else if (strncmp(argv[i], "--config=", 9) == 0) {
+            if (load_config_file(argv[i] + 9, &defaults) != 0) {
+                exit(1);
+            }
+        }
+        // any config key as --key=value, e.g. --l2-size=512K
+        else if (strncmp(argv[i], "--", 2) == 0 && strchr(argv[i], '=')) {
+            const char* value = strchr(argv[i], '=') + 1;
+            char key[CONFIG_MAX_LINE];
+            snprintf(key, sizeof(key), "%.*s", (int) (value - argv[i] - 3), argv[i] + 2);
+            if (set_config_key(&defaults, key, value) != 0) {
+                fprintf(stderr, "Invalid option %s\n", argv[i]);
+                exit(1);
+            }
+        }
+        // -n / -m only drop the title
+        else if (strcmp(argv[i], "-n") != 0 && strcmp(argv[i], "-m") != 0) {
+            fprintf(stderr, "Invalid option %s\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    // one simulator per configuration
+    CacheSim* sims[MAX_SWEEP_CONFIGS];
+    size_t num_sims = 0;
+
+    char error[CONFIG_MAX_LINE];
+    if (check_config(&defaults, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Invalid configuration: %s\n", error);
+        exit(1);
+    }
+    CacheConfig configs[MAX_SWEEP_CONFIGS] = { defaults };
+    int num_configs = 1;
+    if (sweep) {
+        num_configs = parse_config_list(sweep, &defaults, configs, MAX_SWEEP_CONFIGS);
+        if (num_configs <= 0) {
+            fprintf(stderr, "Invalid sweep configurations: %s (at most %d)\n", sweep, MAX_SWEEP_CONFIGS);
+            exit(1);
+        }
+    }
+    if (partitioned && check_partitions(configs, num_configs, PARTITIONS, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Invalid partitioning: %s\n", error);
+        exit(1);
+    }
+    if (PIPELINE && (PARTITIONS > 1 || REPLAY)) {
+        fprintf(stderr, "Error: --pipeline runs without --partitions or --replay\n");
+        exit(1);
+    }
+    if (CAPTURE && (num_configs > 1 || PARTITIONS > 1 || REPLAY)) {
+        fprintf(stderr, "Error: --capture takes one configuration, without --partitions or --replay\n");
+        exit(1);
+    }
+    if (CAPTURE && (configs[0].l1d.prefetch != PREFETCH_NONE || configs[0].issue_window || configs[0].classify)) {
+        fprintf(stderr, "Error: --capture runs without an L1 dcache prefetcher, --issue-window or --classify-misses\n");
+        exit(1);
+    }
+    if (SAMPLE.method != SAMPLE_NONE) {
+        if (PARTITIONS > 1 || PIPELINE || CAPTURE || REPLAY) {
+            fprintf(stderr, "Error: sampling runs without --partitions, --pipeline, --capture or --replay\n");
+            exit(1);
+        }
+        if (check_sample(&SAMPLE, configs, num_configs, error, sizeof(error)) != 0) {
+            fprintf(stderr, "Invalid sampling: %s\n", error);
+            exit(1);
+        }
+    }
+    if ((CHECKPOINT.save || CHECKPOINT.restore)
+        && (PARTITIONS > 1 || PIPELINE || CAPTURE || REPLAY || SAMPLE.method != SAMPLE_NONE)) {
+        fprintf(stderr, "Error: checkpoints run without --partitions, --pipeline, --capture, --replay or sampling\n");
+        exit(1);
+    }
+    if (INTERVAL.filename && (PARTITIONS > 1 || PIPELINE || CAPTURE || REPLAY || SAMPLE.method != SAMPLE_NONE
+                              || CHECKPOINT.save || CHECKPOINT.restore)) {
+        fprintf(stderr, "Error: --interval runs without --partitions, --pipeline, --capture, --replay, sampling or checkpoints\n");
+        exit(1);
+    }
+    if (PROFILING && !PROFILE) {
+        fprintf(stderr, "Error: --profile needs a build with make PROFILE=1\n");
+        exit(1);
+    }
+    if (PROFILING && (PARTITIONS > 1 || PIPELINE)) {
+        fprintf(stderr, "Error: --profile runs without --partitions or --pipeline\n");
+        exit(1);
+    }
+    if (REPLAY) {
+        if (miss_stream_info(argv[1], &REPLAY_INFO) != 0) {
+            fprintf(stderr, "Error: %s isn't an L1 miss stream from --capture\n", argv[1]);
+            exit(1);
+        }
+        for (int i = 0; i < num_configs; i++) {
+            if (check_miss_stream(&REPLAY_INFO, &configs[i], error, sizeof(error)) != 0) {
+                fprintf(stderr, "Invalid replay configuration: %s\n", error);
+                exit(1);
+            }
+            // captured misses carry no payloads
+            configs[i].tags_only = 1;
+        }
+    }
+    for (int i = 0; i < num_configs; i++) {
+        sims[num_sims++] = create_simulator(&configs[i]);
+    }
+    if (CHECKPOINT.restore && load_checkpoint(CHECKPOINT.restore, sims, num_sims, &RESTORED, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Invalid checkpoint: %s\n", error);
+        exit(1);
+    }
+    if (INTERVAL.filename && interval_writer_open(&INTERVAL_WRITER, INTERVAL.filename, sims, num_sims, &ENERGY_MODEL) != 0) {
+        fprintf(stderr, "Error: Unable to create %s\n", INTERVAL.filename);
+        exit(1);
+    }
+    if (CAPTURE && miss_stream_start(sims[0], CAPTURE) != 0) {
+        fprintf(stderr, "Error: Unable to create %s\n", CAPTURE);
+        exit(1);
+    }
+
+    // print args
+    printf("File: %s\n\n", argv[1]);
+
+    // simulation
+#if PROFILE
+    if (PROFILING) {
+        profile_start();
+    }
+#endif
+    process_dinero_trace(argv[1], sims, num_sims);
+
+    // energy counters
+    if (counters) {
+        FILE* file = fopen(counters, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Error: Unable to create %s\n", counters);
+            exit(1);
+        }
+        write_energy_counters_header(file);
+        for (size_t i = 0; i < num_sims; i++) {
+            write_energy_counters(file, i, sims[i]->has_l3, &sims[i]->stats.energy);
+        }
+        fclose(file);
+    }
+
+    // stats
+    for (size_t i = 0; i < num_sims; i++) {
+        print_stats(sims[i]);
+
+        if (SAMPLE.method != SAMPLE_NONE) {
+            print_sample_estimates(&SAMPLES[i], &SAMPLE, sims[i]->has_l3, &ENERGY_MODEL);
+            free_samples(&SAMPLES[i]);
+        }
+
+        printf("==========================\n");
+
+        destroy_simulator(sims[i]);
+    }
+
+#if PROFILE
+    if (PROFILING) {
+        print_profile();
+    }
+#endif
+
+    return 0;
+}
+
+
+/**
+ * Print a lil title
+*/
+void print_title() {
+    printf("_________               .__               _________.__              .__          __                \n");
+    printf("\\_   ___ \\_____    ____ |  |__   ____    /   _____/|__| _____  __ __|  | _____ _/  |_  ___________ \n");
+    printf("/    \\  \\/\\__  \\ _/ ___\\|  |  \\_/ __ \\   \\_____  \\ |  |/     \\|  |  \\  | \\__  \\   __\\/  _  \\_  __ \n");
+    printf("\\     \\____/ __ \\\\  \\___|   Y  \\  ___/   /        \\|  |  Y Y  \\  |  /  |__/ __ \\|  | (  <_> )  | \\/\n");
+    printf(" \\______  (____  /\\___  >___|  /\\___  > /_______  /|__|__|_|  /____/|____(____  /__|  \\____/|__|  \n");
+    printf("        \\/     \\/     \\/     \\/     \\/          \\/          \\/                \\/                   \n");
+    printf("_________   _________ _________________  ______ \n");
+    printf("\\_   ___ \\ /   _____/ \\_____  \\______  \\/  __  \\ \n");
+    printf("/    \\  \\/ \\_____  \\    _(__  <   /    />      < \n");
+    printf("\\     \\____/        \\  /       \\ /    //   --   \\\n");
+    printf(" \\______  /_______  / /______  //____/ \\______  / \n");
+    printf("        \\/        \\/         \\/               \\/  \n\n");
+}
+
+
+/**
+ * Print Stats
+*/
+void print_stats(CacheSim* sim) {
+    PROFILE_SCOPE(PROFILE_STATS);
+    EnergyTotals energy;
+    compute_energy(&sim->stats.energy, sim->has_l3, &ENERGY_MODEL, &energy);
+
+    printf("\nStatistics: \n");
+
+    printf("Set Associativity: %lu\n", sim->l2_cache.associativity);
+    printf("L2 Replacement Policy: %s\n\n", policy_name(sim->config.l2.policy));
+
+    // total access time and energy
+    printf("Total Access Time and Energy:\n");
+    printf("Total Access Time      | Total Dynamic Energy (W) | Total Static Energy (pJ) \n");
+    printf("-----------------------|--------------------------|-------------------------\n");
+    printf("%-15.2f        | %f           | %f\n", sim->stats.simulation_clock,
+        energy.total_dynamic, energy.total_static);
+   printf("\n");
+
+        // L1 cache statistics
+    printf("L1 Cache Statistics:\n");
+    printf("Component | # Hits      | # Misses    | Dynamic Energy (W) | Static Energy (pJ) \n");
+    printf("----------|-------------|-------------|--------------------|-------------------\n");
+    printf("L1 icache | %-9lu   | %-9lu   | %-9.2f   | %-9.2f\n",
+        sim->stats.l1_icache_hits, sim->stats.l1_icache_misses, energy.dynamic_energy[PART_L1I], energy.static_energy[PART_L1I]);
+    printf("L1 dcache | %-9lu   | %-9lu   | %-9.2f   | %-9.2f\n",
+        sim->stats.l1_dcache_hits, sim->stats.l1_dcache_misses, energy.dynamic_energy[PART_L1D], energy.static_energy[PART_L1D]);
+   printf("\n");
+
+    // L2 cache statistics
+    printf("L2 Cache Statistics:\n");
+    printf("Component | # Hits      | # Misses    | Dynamic Energy (W) | Static Energy (pJ) \n");
+    printf("----------|-------------|-------------|--------------------|-------------------\n");
+    printf("L2        | %-9lu   | %-9lu   | %-9.2f  | %-9.2f\n",
+        sim->stats.l2_hits, sim->stats.l2_misses, energy.dynamic_energy[PART_L2], energy.static_energy[PART_L2]);
+    printf("\n");
+
+    // L3 cache statistics
+    if (sim->has_l3) {
+        printf("L3 Cache Statistics:\n");
+        printf("Component | # Hits      | # Misses    | Dynamic Energy (W) | Static Energy (pJ) \n");
+        printf("----------|-------------|-------------|--------------------|-------------------\n");
+        printf("L3        | %-9lu   | %-9lu   | %-9.2f  | %-9.2f\n",
+            sim->stats.l3_hits, sim->stats.l3_misses, energy.dynamic_energy[PART_L3], energy.static_energy[PART_L3]);
+        printf("\n");
+    }
+
+    // DRAM stats
+    printf("DRAM Statistics:\n");
+    printf("Component | # Hits      | # Misses    | Dynamic Energy (W) | Static Energy (pJ) \n");
+    printf("----------|-------------|-------------|--------------------|-------------------\n");
+    printf("DRAM      | %-9lu   | N/A         | %-9.2f   | %-9.2f\n",
+        sim->stats.dram_hits, energy.dynamic_energy[PART_DRAM], energy.static_energy[PART_DRAM]);
+   printf("\n");
+
+    // non-blocking timing: memory-level parallelism is the average number of
+    // misses outstanding while there is at least one, the miss latency counts
+    // the wait for an MSHR
+    if (sim->config.issue_window) {
+        const TimingStats* timing = &sim->stats.timing;
+        printf("Non-blocking Timing (issue window %d, MSHRs L1i %d, L1d %d, L2 %d", sim->config.issue_window,
+            sim->config.l1i.mshrs, sim->config.l1d.mshrs, sim->config.l2.mshrs);
+        if (sim->has_l3) {
+            printf(", L3 %d", sim->config.l3.mshrs);
+        }
+        printf("):\n");
+        printf("Total Access Time      | Speedup | MLP     | Avg Miss Latency | # Misses    | # Merged    | MSHR Stall Time\n");
+        printf("-----------------------|---------|---------|------------------|-------------|-------------|----------------\n");
+        printf("%-15.2f        | %-7.2f | %-7.2f | %-16.2f | %-9lu   | %-9lu   | %.2f\n", timing->clock,
+            timing->clock > 0 ? sim->stats.simulation_clock / timing->clock : 0,
+            timing->miss_busy > 0 ? timing->miss_latency / timing->miss_busy : 0,
+            timing->misses ? (timing->mshr_stall + timing->miss_latency) / timing->misses : 0,
+            timing->misses, timing->merged, timing->mshr_stall);
+        printf("\n");
+    }
+
+    // 3C miss classification: compulsory misses are first references,
+    // capacity misses would miss in a fully associative LRU cache of the same
+    // size too, conflict misses would hit there
+    if (sim->config.classify) {
+        const char* names[NUM_CLASSIFIED] = { "L1i", "L1d", "L2", "L3" };
+        const unsigned long int misses[NUM_CLASSIFIED] = { sim->stats.l1_icache_misses, sim->stats.l1_dcache_misses,
+            sim->stats.l2_misses, sim->stats.l3_misses };
+
+        printf("Miss Classification:\n");
+        printf("Component | # Misses    | # Compulsory | # Capacity  | # Conflict \n");
+        printf("----------|-------------|--------------|-------------|------------\n");
+        for (int i = 0; i < NUM_CLASSIFIED; i++) {
+            const MissClasses* classes = &sim->stats.classes[i];
+            if (i == CLASS_L3 && !sim->has_l3) {
+                continue;
+            }
+            printf("%-9s | %-9lu   | %-9lu    | %-9lu   | %-9lu\n", names[i], misses[i],
+                classes->compulsory, classes->capacity, classes->conflict);
+        }
+        printf("\n");
+    }
+
+    // prefetchers: accuracy is useful / issued, coverage the share of would be
+    // misses they removed, timeliness the share of useful ones that arrived in time
+    if (sim->config.l1d.prefetch != PREFETCH_NONE || sim->config.l2.prefetch != PREFETCH_NONE) {
+        const char* names[2] = { "L1 dcache", "L2" };
+        const int kinds[2] = { sim->config.l1d.prefetch, sim->config.l2.prefetch };
+        const PrefetchStats* prefetch[2] = { &sim->stats.l1d_prefetch, &sim->stats.l2_prefetch };
+
+        printf("Prefetch Statistics:\n");
+        printf("Component | Prefetcher | # Issued    | # Useful    | # Late      | Accuracy | Coverage | Timeliness | Extra DRAM Reads | Extra DRAM Energy (pJ)\n");
+        printf("----------|------------|-------------|-------------|-------------|----------|----------|------------|------------------|-----------------------\n");
+        for (int i = 0; i < 2; i++) {
+            const PrefetchStats* p = prefetch[i];
+            if (kinds[i] == PREFETCH_NONE) {
+                continue;
+            }
+            printf("%-9s | %-10s | %-9lu   | %-9lu   | %-9lu   | %-8.4f | %-8.4f | %-10.4f | %-16lu | %.2f\n",
+                names[i], prefetch_name(kinds[i]), p->issued, p->useful, p->late,
+                p->issued ? (double) p->useful / p->issued : 0,
+                p->useful + p->misses ? (double) p->useful / (p->useful + p->misses) : 0,
+                p->useful ? (double) (p->useful - p->late) / p->useful : 0,
+                p->dram_reads, prefetch_dram_energy(p, &ENERGY_MODEL));
+        }
+        printf("\n");
+    }
+}
+
+
+/**
+ * Process File
+ * Every simulator sees the same decoded records, one batch at a time.
+*/
+void process_dinero_trace(const char* filename, CacheSim** sims, size_t num_sims) {
+    printf("Running simulation ...\n");
+
+    PipelineStats pipeline;
+    PartitionStats partition;
+    CheckpointMark mark;
+    RunResult result;
+    if (REPLAY) {
+        result = run_miss_stream(filename, &REPLAY_INFO, sims, num_sims);
+    } else if (INTERVAL.filename) {
+        result = run_interval_trace(filename, TRACE_READER, sims, num_sims, &INTERVAL, &INTERVAL_WRITER);
+    } else if (CHECKPOINT.save || CHECKPOINT.restore) {
+        result = run_checkpointed_trace(filename, TRACE_READER, sims, num_sims,
+            CHECKPOINT.restore ? &RESTORED : NULL, CHECKPOINT.save ? CHECKPOINT.save_at : 0, &mark);
+    } else if (SAMPLE.method != SAMPLE_NONE) {
+        result = run_sampled_trace(filename, TRACE_READER, sims, num_sims, &SAMPLE, SAMPLES);
+    } else if (PARTITIONS > 1) {
+        result = run_partitioned_trace(filename, TRACE_READER, sims, num_sims, PARTITIONS, &partition);
+    } else if (PIPELINE) {
+        result = run_pipelined_trace(filename, TRACE_READER, sims, num_sims, &pipeline);
+    } else {
+        result = run_dinero_trace(filename, TRACE_READER, sims, num_sims);
+    }
+
+    if (result.status == RUN_OPEN_FAILED) {
+        fprintf(stderr, "Error: Unable to open trace file. Is it in Dinero 3 .din format?\n");
+        exit(1);
+    }
+    if (result.status == RUN_SEEK_FAILED) {
+        fprintf(stderr, "Error: %s wasn't checkpointed on this trace.\n", CHECKPOINT.restore);
+        exit(1);
+    }
+    if (result.status == RUN_INVALID_OP) {
+        printf("Operation: %c, Address: 0x%lx, Value: 0x%lx\n",
+            result.record.operation, result.record.address, result.record.value);
+        fprintf(stderr, "Error: Invalid operation code or arguments.\n");
+        exit(1);
+    }
+    if (result.status == RUN_MALFORMED) {
+        fprintf(stderr, "Error: Malformed trace record on line %lu.\n", result.line);
+        exit(1);
+    }
+
+    printf("Simulation Complete.\n\n");
+#if PROFILE
+    profile_records(result.records);
+#endif
+
+    if (CAPTURE) {
+        unsigned long int misses = sims[0]->l1_misses->count;
+        if (miss_stream_finish(sims[0], CAPTURE, result.records) != 0) {
+            fprintf(stderr, "Error: Unable to write %s\n", CAPTURE);
+            exit(1);
+        }
+        printf("Captured %lu L1 misses and write backs of %lu records to %s\n\n", misses, result.records, CAPTURE);
+    }
+
+    if (INTERVAL.filename) {
+        if (interval_writer_close(&INTERVAL_WRITER) != 0) {
+            fprintf(stderr, "Error: Unable to write %s\n", INTERVAL.filename);
+            exit(1);
+        }
+        unsigned long int rows = 0;
+        for (size_t i = 0; i < num_sims; i++) {
+            rows += INTERVAL_WRITER.intervals[i];
+        }
+        printf("Wrote %lu intervals to %s\n\n", rows, INTERVAL.filename);
+    }
+    if (CHECKPOINT.restore) {
+        printf("Resumed from %s after %lu records\n\n", CHECKPOINT.restore, RESTORED.records);
+    }
+    if (CHECKPOINT.save) {
+        if (save_checkpoint(CHECKPOINT.save, sims, num_sims, &mark) != 0) {
+            fprintf(stderr, "Error: Unable to write %s\n", CHECKPOINT.save);
+            exit(1);
+        }
+        printf("Checkpointed %lu records to %s\n\n", mark.records, CHECKPOINT.save);
+    }
+
+    if (REPLAY) {
+        printf("Replayed the L1 misses of %lu records\n\n", REPLAY_INFO.records);
+    } else if (PARTITIONS > 1) {
+        print_partition_stats(&partition);
+    } else if (PIPELINE) {
+        print_pipeline_stats(&pipeline);
+    }
+}
+
+
+/**
+ * Convert a text trace to the packed binary format
+*/
+void convert_dinero_trace(const char* input, const char* output) {
+    TraceReader reader;
+    if (trace_open(&reader, input, TRACE_READER) != 0) {
+        fprintf(stderr, "Error: Unable to open trace file. Is it in Dinero 3 .din format?\n");
+        exit(1);
+    }
+
+    TraceWriter writer;
+    if (trace_writer_open(&writer, output) != 0) {
+        fprintf(stderr, "Error: Unable to create %s\n", output);
+        exit(1);
+    }
+
+    TraceRecord record;
+    int status;
+    while ((status = trace_next(&reader, &record)) == TRACE_RECORD) {
+        if (trace_write(&writer, &record) != 0) {
+            printf("Operation: %c, Address: 0x%lx, Value: 0x%lx\n", record.operation, record.address, record.value);
+            fprintf(stderr, "Error: Unable to write record on line %lu.\n", reader.line);
+            exit(1);
+        }
+    }
+
+    if (status == TRACE_MALFORMED) {
+        fprintf(stderr, "Error: Malformed trace record on line %lu.\n", reader.line);
+        exit(1);
+    }
+
+    if (trace_writer_close(&writer) != 0) {
+        fprintf(stderr, "Error: Unable to write %s\n", output);
+        exit(1);
+    }
+    trace_close(&reader);
+
+    printf("Converted %lu records to %s\n", writer.count, output);
+}
@@ -0,0 +1,272 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "./miss_stream.h"
+
+
+/**
+ * Store a little endian integer
+*/
+static void store_le(unsigned char* p, unsigned long int value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+
+/**
+ * Read a little endian integer
+*/
+static unsigned long int load_le(const unsigned char* p, int bytes) {
+    unsigned long int value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+
+/**
+ * Trailer fields in file order, read or written through the same list
+*/
+static void trailer_fields(MissStreamInfo* info, unsigned long int* fields[MISS_STREAM_FIELDS],
+                           unsigned long int policies[2], unsigned long int* clock) {
+    CacheConfig* config = &info->config;
+    CacheStats* stats = &info->stats;
+    int n = 0;
+
+    fields[n++] = &info->records;
+    fields[n++] = &config->block_size;
+    fields[n++] = &config->l1i.size;
+    fields[n++] = &config->l1i.associativity;
+    fields[n++] = &policies[0];
+    fields[n++] = &config->l1d.size;
+    fields[n++] = &config->l1d.associativity;
+    fields[n++] = &policies[1];
+    fields[n++] = &stats->l1_icache_hits;
+    fields[n++] = &stats->l1_icache_misses;
+    fields[n++] = &stats->l1_dcache_hits;
+    fields[n++] = &stats->l1_dcache_misses;
+    fields[n++] = &stats->energy.ticks;
+    for (int part = 0; part < NUM_PARTS; part++) {
+        fields[n++] = &stats->energy.active[part];
+    }
+    for (int part = 0; part < NUM_PARTS; part++) {
+        fields[n++] = &stats->energy.fills[part];
+    }
+    fields[n++] = clock;
+}
+
+
+/**
+ * Send a simulator's L1 misses and write backs to a new miss stream
+ * instead of its L2. Returns 0 on success, -1 if the file can't be created.
+*/
+int miss_stream_start(CacheSim* sim, const char* filename) {
+    TraceWriter* writer = malloc(sizeof(TraceWriter));
+    if (!writer) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    if (trace_writer_open(writer, filename) != 0) {
+        free(writer);
+        return -1;
+    }
+    sim->l1_misses = writer;
+    return 0;
+}
+
+
+/**
+ * Close the miss stream and append the trailer with what the L1s did.
+ * Returns 0 on success, -1 on a write error.
+*/
+int miss_stream_finish(CacheSim* sim, const char* filename, unsigned long int records) {
+    int status = trace_writer_close(sim->l1_misses);
+    free(sim->l1_misses);
+    sim->l1_misses = NULL;
+
+    MissStreamInfo info;
+    memset(&info, 0, sizeof(info));
+    info.records = records;
+    info.config = sim->config;
+    info.stats = sim->stats;
+
+    unsigned long int* fields[MISS_STREAM_FIELDS];
+    unsigned long int policies[2] = { sim->config.l1i.policy, sim->config.l1d.policy };
+    unsigned long int clock;
+    memcpy(&clock, &sim->stats.simulation_clock, sizeof(clock));
+    trailer_fields(&info, fields, policies, &clock);
+
+    unsigned char trailer[MISS_STREAM_TRAILER_SIZE];
+    memcpy(trailer, MISS_STREAM_MAGIC, 4);
+    store_le(trailer + 4, MISS_STREAM_VERSION, 4);
+    for (int i = 0; i < MISS_STREAM_FIELDS; i++) {
+        store_le(trailer + 8 + 8 * i, *fields[i], 8);
+    }
+
+    FILE* file = fopen(filename, "ab");
+    if (file == NULL) {
+        return -1;
+    }
+    if (fwrite(trailer, 1, sizeof(trailer), file) != sizeof(trailer)) {
+        status = -1;
+    }
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+
+/**
+ * Read the trailer of a miss stream.
+ * Returns 0 on success, -1 if the file isn't a miss stream of this version.
+*/
+int miss_stream_info(const char* filename, MissStreamInfo* info) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    unsigned char trailer[MISS_STREAM_TRAILER_SIZE];
+    int status = 0;
+    if (fseek(file, -(long) sizeof(trailer), SEEK_END) != 0
+        || fread(trailer, 1, sizeof(trailer), file) != sizeof(trailer)
+        || memcmp(trailer, MISS_STREAM_MAGIC, 4) != 0
+        || load_le(trailer + 4, 4) != MISS_STREAM_VERSION) {
+        status = -1;
+    }
+    fclose(file);
+    if (status != 0) {
+        return -1;
+    }
+
+    memset(info, 0, sizeof(*info));
+    default_config(&info->config);
+
+    unsigned long int* fields[MISS_STREAM_FIELDS];
+    unsigned long int policies[2];
+    unsigned long int clock;
+    trailer_fields(info, fields, policies, &clock);
+    for (int i = 0; i < MISS_STREAM_FIELDS; i++) {
+        *fields[i] = load_le(trailer + 8 + 8 * i, 8);
+    }
+    info->config.l1i.policy = policies[0];
+    info->config.l1d.policy = policies[1];
+    memcpy(&info->stats.simulation_clock, &clock, sizeof(clock));
+    return 0;
+}
+
+
+/**
+ * Check a configuration has the L1s a stream was captured with.
+ * Returns 0 if so, -1 with the difference in error if not.
+*/
+int check_miss_stream(const MissStreamInfo* info, const CacheConfig* config, char* error, size_t error_size) {
+    const CacheConfig* captured = &info->config;
+    if (config->block_size != captured->block_size) {
+        snprintf(error, error_size, "block size %lu, captured with %lu", config->block_size, captured->block_size);
+        return -1;
+    }
+
+    // the L1 hits the non-blocking model overlaps misses with aren't captured
+    if (config->issue_window) {
+        snprintf(error, error_size, "issue window %d, the non-blocking timing model needs the L1 hits", config->issue_window);
+        return -1;
+    }
+
+    // the shadows of the L1s need their hits too
+    if (config->classify) {
+        snprintf(error, error_size, "miss classification needs the L1 hits");
+        return -1;
+    }
+
+    // captures are taken without one (main.c)
+    if (config->l1d.prefetch != PREFETCH_NONE) {
+        snprintf(error, error_size, "L1 dcache prefetcher %s, captured without one", prefetch_name(config->l1d.prefetch));
+        return -1;
+    }
+
+    // prefetch fills arrive on the clock, which the replay runs without the L1 time
+    if (config->l2.prefetch != PREFETCH_NONE) {
+        snprintf(error, error_size, "L2 prefetcher %s, its fill times need the L1 time of every access",
+            prefetch_name(config->l2.prefetch));
+        return -1;
+    }
+
+    const LevelConfig* levels[2] = { &config->l1i, &config->l1d };
+    const LevelConfig* captured_levels[2] = { &captured->l1i, &captured->l1d };
+    const char* names[2] = { "L1 icache", "L1 dcache" };
+    for (int i = 0; i < 2; i++) {
+        if (levels[i]->size != captured_levels[i]->size
+            || levels[i]->associativity != captured_levels[i]->associativity
+            || levels[i]->policy != captured_levels[i]->policy) {
+            snprintf(error, error_size, "%s %lu B %lu way %s, captured with %lu B %lu way %s", names[i],
+                levels[i]->size, levels[i]->associativity, policy_name(levels[i]->policy),
+                captured_levels[i]->size, captured_levels[i]->associativity, policy_name(captured_levels[i]->policy));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Replay a miss stream into the L2 of every simulator, then add the
+ * captured L1 stats so the totals are those of the whole trace.
+*/
+RunResult run_miss_stream(const char* filename, const MissStreamInfo* info, CacheSim** sims, size_t num_sims) {
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+
+    TraceReader reader;
+    if (trace_open(&reader, filename, READER_MMAP) != 0) {
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+    if (reader.kind != READER_BINARY) {
+        trace_close(&reader);
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+
+    TraceRecord* batch = malloc(SWEEP_BATCH_SIZE * sizeof(TraceRecord));
+    if (!batch) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    int status = TRACE_RECORD;
+    while (status == TRACE_RECORD && result.status == RUN_OK) {
+        size_t count = 0;
+        while (count < SWEEP_BATCH_SIZE && (status = trace_next(&reader, &batch[count])) == TRACE_RECORD) {
+            count++;
+        }
+
+        for (size_t i = 0; i < num_sims && result.status == RUN_OK; i++) {
+            for (size_t j = 0; j < count; j++) {
+                if (replay_l1_miss(sims[i], &batch[j]) != 0) {
+                    result.status = RUN_INVALID_OP;
+                    result.record = batch[j];
+                    break;
+                }
+            }
+        }
+    }
+
+    if (result.status == RUN_OK && status == TRACE_MALFORMED) {
+        result.status = RUN_MALFORMED;
+        result.line = reader.line;
+    }
+    if (result.status == RUN_OK) {
+        for (size_t i = 0; i < num_sims; i++) {
+            add_stats(&sims[i]->stats, &info->stats);
+        }
+        result.records = info->records;
+    }
+
+    free(batch);
+    trace_close(&reader);
+    return result;
+}
@@ -0,0 +1,33 @@
+#ifndef MISS_STREAM_H
+#define MISS_STREAM_H
+
+#include "./cache_simulator.h"
+
+// L1 miss stream: what the L1s of one run sent the L2, for replaying
+// against other L2 / L3 configurations without simulating the L1s again
+//
+// records: a binary trace (trace.h), INSTR_FETCH for an L1 icache miss,
+//          MEMORY_READ for an L1 dcache miss, MEMORY_WRITE for an L1 dcache
+//          write back, so trace tools read it like any .dinb
+// trailer: "L1MS" magic, u32 version, then MISS_STREAM_FIELDS u64 (little
+//          endian): trace records, block size, L1 geometries and the stats
+//          the L1s produced on their own
+#define MISS_STREAM_MAGIC   "L1MS"
+#define MISS_STREAM_VERSION 1
+#define MISS_STREAM_FIELDS  24
+#define MISS_STREAM_TRAILER_SIZE (8 + 8 * MISS_STREAM_FIELDS)
+
+// the L1 side of a captured run
+typedef struct {
+    unsigned long int records;      // records of the original trace
+    CacheConfig config;             // block size and L1s, the rest is unused
+    CacheStats stats;               // L1 hits, misses, time and energy counters
+} MissStreamInfo;
+
+int miss_stream_start(CacheSim* sim, const char* filename);
+int miss_stream_finish(CacheSim* sim, const char* filename, unsigned long int records);
+int miss_stream_info(const char* filename, MissStreamInfo* info);
+int check_miss_stream(const MissStreamInfo* info, const CacheConfig* config, char* error, size_t error_size);
+RunResult run_miss_stream(const char* filename, const MissStreamInfo* info, CacheSim** sims, size_t num_sims);
+
+#endif
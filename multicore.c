@@ -0,0 +1,653 @@
+#define _DEFAULT_SOURCE
+
+#include <math.h>
+#include <unistd.h>
+
+#include "./multicore.h"
+#include "./wall_clock.h"
+
+
+// one host thread's share of the cores
+typedef struct {
+    Multicore* mc;
+    int index;
+} Worker;
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Private L1s, run by each core's host thread
+*/
+
+
+/**
+ * Cold private L1 with the geometry and policy of level
+*/
+static void private_init(PrivateCache* cache, const CacheConfig* config, const LevelConfig* level) {
+    init_level(&cache->level, level_num_sets(config, level), level->associativity, config->block_size, 0, level->policy);
+    if (level_indexed(config, level)) {
+        level_enable_index(&cache->level);
+    }
+    size_t entries = cache->level.num_sets * cache->level.associativity;
+    cache->blocks = calloc(entries, sizeof(unsigned long int));
+    cache->exclusive = calloc((entries + 63) / 64, sizeof(uint64_t));
+    if (!cache->blocks || !cache->exclusive) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+}
+
+static void private_free(PrivateCache* cache) {
+    free_level(&cache->level);
+    free(cache->blocks);
+    free(cache->exclusive);
+}
+
+
+/**
+ * Entry holding block, -1 if the cache doesn't have it
+*/
+static long private_find(const PrivateCache* cache, unsigned long int block) {
+    const CacheLevel* level = &cache->level;
+    unsigned long int address = block << level->block_shift;
+    size_t set = level_set_index(level, address);
+    long way = level_lookup(level, set, level_tag(level, address));
+    return way < 0 ? -1 : (long) level_entry(level, set, way);
+}
+
+
+/**
+ * Queue a request for the next weave
+*/
+static void core_request(Core* core, int type, unsigned long int block, int l1) {
+    if (core->num_requests == core->capacity) {
+        core->capacity = core->capacity ? 2 * core->capacity : 1024;
+        core->requests = realloc(core->requests, core->capacity * sizeof(CoherenceRequest));
+        if (!core->requests) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+    }
+    core->requests[core->num_requests++] = (CoherenceRequest) { core->clock, block, type, l1 };
+}
+
+
+/**
+ * Make room for block in its set and fill it clean and shared, the weave
+ * decides whether it's exclusive. The line replaced is written back if
+ * modified, else the directory is told it's gone.
+*/
+static size_t core_fill(Core* core, PrivateCache* cache, int l1, unsigned long int address) {
+    CacheLevel* level = &cache->level;
+    size_t set = level_set_index(level, address);
+    size_t way = policy_victim(level, set);
+    size_t entry = level_entry(level, set, way);
+
+    if (level_bit(level->valid, entry)) {
+        int modified = level_bit(level->dirty, entry);
+        core_request(core, modified ? REQ_PUTM : REQ_PUTS, cache->blocks[entry], l1);
+    }
+
+    level_fill(level, set, way, level_tag(level, address));
+    level_set_bit(level->dirty, entry, 0);
+    level_set_bit(cache->exclusive, entry, 0);
+    cache->blocks[entry] = address >> level->block_shift;
+    policy_insert(level, set, way);
+    return entry;
+}
+
+
+/**
+ * Read through a private L1: hits in any valid state stay local
+*/
+static void core_read(Core* core, PrivateCache* cache, int l1, unsigned long int address,
+                      unsigned long int* hits, unsigned long int* misses) {
+    CacheLevel* level = &cache->level;
+    size_t set = level_set_index(level, address);
+    long way = level_lookup(level, set, level_tag(level, address));
+    if (way >= 0) {
+        (*hits)++;
+        policy_touch(level, set, way);
+        return;
+    }
+
+    (*misses)++;
+    core_fill(core, cache, l1, address);
+    core_request(core, REQ_GETS, address >> level->block_shift, l1);
+}
+
+
+/**
+ * Write through the L1 dcache: modified and exclusive lines stay local, a
+ * shared line needs an upgrade, a miss fetches the block to modify it
+*/
+static void core_write(Core* core, unsigned long int address) {
+    PrivateCache* cache = &core->l1d;
+    CacheLevel* level = &cache->level;
+    size_t set = level_set_index(level, address);
+    long way = level_lookup(level, set, level_tag(level, address));
+    unsigned long int block = address >> level->block_shift;
+
+    if (way >= 0) {
+        size_t entry = level_entry(level, set, way);
+        core->stats.l1d_hits++;
+        policy_touch(level, set, way);
+        if (!level_bit(level->dirty, entry) && !level_bit(cache->exclusive, entry)) {
+            core->stats.upgrades++;
+            core_request(core, REQ_UPGRADE, block, MEMORY_WRITE);
+        }
+        level_set_bit(cache->exclusive, entry, 0);
+        level_set_bit(level->dirty, entry, 1);
+        return;
+    }
+
+    core->stats.l1d_misses++;
+    size_t entry = core_fill(core, cache, MEMORY_WRITE, address);
+    level_set_bit(level->dirty, entry, 1);
+    core_request(core, REQ_GETM, block, MEMORY_WRITE);
+}
+
+
+/**
+ * Run a core's trace until its clock passes the end of the epoch
+*/
+static void core_run(Core* core, double epoch_end) {
+    while (!core->done && core->clock + core->delay < epoch_end) {
+        TraceRecord record;
+        int status = trace_next(&core->reader, &record);
+        if (status != TRACE_RECORD) {
+            core->done = 1;
+            core->status = status == TRACE_MALFORMED ? RUN_MALFORMED : RUN_OK;
+            break;
+        }
+        if (!record_valid(&record)) {
+            core->done = 1;
+            core->status = RUN_INVALID_OP;
+            core->record = record;
+            break;
+        }
+
+        // ignore and flush records do nothing, as in the single core simulator
+        int opcode = record.operation - '0';
+        if (opcode > INSTR_FETCH) {
+            continue;
+        }
+        core->stats.records++;
+        core->clock += L1_ACCESS_TIME;
+
+        if (opcode == INSTR_FETCH) {
+            core_read(core, &core->l1i, INSTR_FETCH, record.address, &core->stats.l1i_hits, &core->stats.l1i_misses);
+        } else if (opcode == MEMORY_READ) {
+            core_read(core, &core->l1d, MEMORY_READ, record.address, &core->stats.l1d_hits, &core->stats.l1d_misses);
+        } else {
+            core_write(core, record.address);
+        }
+    }
+}
+
+
+/**
+ * Host thread: run its cores through every epoch
+*/
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    Multicore* mc = worker->mc;
+
+    while (1) {
+        pthread_barrier_wait(&mc->start);
+        if (mc->stop) {
+            break;
+        }
+        for (int c = worker->index; c < mc->num_cores; c += mc->num_threads) {
+            core_run(&mc->cores[c], mc->epoch_end);
+        }
+        pthread_barrier_wait(&mc->finish);
+    }
+    return NULL;
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Weave: the epoch's requests of every core against the directory and the
+ * shared L2, one at a time on the main thread
+*/
+
+
+/**
+ * Directory entry of a block, added if the block is new
+*/
+static DirectoryEntry* directory_find(Directory* dir, unsigned long int block) {
+    if (2 * (dir->used + 1) > dir->size) {
+        DirectoryEntry* old = dir->entries;
+        size_t old_size = dir->size;
+        dir->size = old_size ? 2 * old_size : DIRECTORY_INITIAL_SIZE;
+        dir->entries = calloc(dir->size, sizeof(DirectoryEntry));
+        if (!dir->entries) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        dir->used = 0;
+        for (size_t i = 0; i < old_size; i++) {
+            if (old[i].used) {
+                *directory_find(dir, old[i].block) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    size_t i = (block * 0x9E3779B97F4A7C15UL) & (dir->size - 1);
+    while (dir->entries[i].used && dir->entries[i].block != block) {
+        i = (i + 1) & (dir->size - 1);
+    }
+    DirectoryEntry* entry = &dir->entries[i];
+    if (!entry->used) {
+        *entry = (DirectoryEntry) { block, 0, 0, -1, 1 };
+        dir->used++;
+    }
+    return entry;
+}
+
+
+/**
+ * Write a modified line back to the shared L2.
+ * Returns the L2 operations it took.
+*/
+static int shared_write_back(Multicore* mc, Core* core, unsigned long int block) {
+    CacheStats* stats = &mc->shared->stats;
+    unsigned long int hits = stats->l2_hits;
+    write_l2_cache(mc->shared, block << mc->shared->l2_cache.block_shift, NULL);
+    // write_l2_cache counts a hit twice, the shared L2 row counts it once
+    if (stats->l2_hits - hits == 2) {
+        stats->l2_hits--;
+    }
+    core->stats.write_backs++;
+    return 1;
+}
+
+
+/**
+ * Take a core's copies of a block away for another core's write.
+ * Returns the L2 operations it took, and whether it had a copy in held.
+*/
+static int invalidate(Multicore* mc, Core* core, unsigned long int block, int* held) {
+    int operations = 0;
+    *held = 0;
+    PrivateCache* caches[2] = { &core->l1i, &core->l1d };
+    for (int i = 0; i < 2; i++) {
+        long entry = private_find(caches[i], block);
+        if (entry < 0) {
+            continue;
+        }
+        CacheLevel* level = &caches[i]->level;
+        if (level_bit(level->dirty, entry)) {
+            operations += shared_write_back(mc, core, block);
+        }
+        level_invalidate(level, entry);
+        level_set_bit(level->dirty, entry, 0);
+        level_set_bit(caches[i]->exclusive, entry, 0);
+        core->stats.invalidations++;
+        *held = 1;
+    }
+    return operations;
+}
+
+
+/**
+ * An owner loses exclusivity to another core's read, writing back if modified
+*/
+static int downgrade(Multicore* mc, Core* core, unsigned long int block) {
+    long entry = private_find(&core->l1d, block);
+    if (entry < 0) {
+        return 0;
+    }
+    int operations = 0;
+    CacheLevel* level = &core->l1d.level;
+    if (level_bit(level->dirty, entry)) {
+        operations += shared_write_back(mc, core, block);
+        level_set_bit(level->dirty, entry, 0);
+    }
+    level_set_bit(core->l1d.exclusive, entry, 0);
+    return operations;
+}
+
+
+/**
+ * Read a block from the shared L2 for a core's miss
+*/
+static int shared_read(Multicore* mc, Core* core, unsigned long int block) {
+    CacheStats* stats = &mc->shared->stats;
+    unsigned long int misses = stats->l2_misses;
+    read_l2_cache(mc->shared, block << mc->shared->l2_cache.block_shift);
+    if (stats->l2_misses != misses) {
+        core->stats.l2_misses++;
+    } else {
+        core->stats.l2_hits++;
+    }
+    return 1;
+}
+
+
+/**
+ * Run one request through the directory and the shared L2, and delay the
+ * core by its latency and the time it waited for the L2
+*/
+static void weave_request(Multicore* mc, int c, const CoherenceRequest* request) {
+    Core* core = &mc->cores[c];
+    uint64_t bit = (uint64_t) 1 << c;
+    DirectoryEntry* entry = directory_find(&mc->directory, request->block);
+    double clock = mc->shared->stats.simulation_clock;
+    double latency = 0;
+    int operations = 0;
+
+    switch (request->type) {
+    case REQ_PUTS:
+        // the other L1 may still hold it
+        if (private_find(&core->l1i, request->block) < 0 && private_find(&core->l1d, request->block) < 0) {
+            entry->sharers &= ~bit;
+            if (entry->owner == c) {
+                entry->owner = -1;
+            }
+        }
+        return;
+
+    case REQ_PUTM:
+        operations += shared_write_back(mc, core, request->block);
+        entry->sharers &= ~bit;
+        entry->owner = -1;
+        break;
+
+    case REQ_GETS:
+        if (entry->invalidated & bit) {
+            core->stats.coherence_misses++;
+            entry->invalidated &= ~bit;
+        }
+        if (entry->owner >= 0 && entry->owner != c) {
+            operations += downgrade(mc, &mc->cores[entry->owner], request->block);
+            entry->owner = -1;
+        }
+        operations += shared_read(mc, core, request->block);
+        entry->sharers |= bit;
+
+        // alone with it: exclusive, so a later write needs no upgrade
+        if (entry->sharers == bit && request->l1 == MEMORY_READ) {
+            long line = private_find(&core->l1d, request->block);
+            if (line >= 0 && !level_bit(core->l1d.level.dirty, line)) {
+                level_set_bit(core->l1d.exclusive, line, 1);
+                entry->owner = c;
+            }
+        }
+        break;
+
+    case REQ_GETM:
+    case REQ_UPGRADE:
+        if (request->type == REQ_GETM && (entry->invalidated & bit)) {
+            core->stats.coherence_misses++;
+        }
+        entry->invalidated &= ~bit;
+        for (int s = 0; s < mc->num_cores; s++) {
+            int held;
+            if (s != c && (entry->sharers >> s & 1)) {
+                operations += invalidate(mc, &mc->cores[s], request->block, &held);
+                if (held) {
+                    entry->invalidated |= (uint64_t) 1 << s;
+                }
+            }
+        }
+        if (request->type == REQ_GETM) {
+            operations += shared_read(mc, core, request->block);
+        } else {
+            // the directory lookup at the L2
+            latency += L2_ACCESS_TIME;
+            operations++;
+        }
+        entry->sharers = bit;
+        entry->owner = c;
+        break;
+    }
+
+    // the L2 takes one operation at a time
+    double at = request->time + core->delay;
+    double start = mc->l2_free > at ? mc->l2_free : at;
+    mc->l2_free = start + operations * L2_ACCESS_TIME;
+
+    latency += mc->shared->stats.simulation_clock - clock;
+    core->stats.l2_wait += start - at;
+    core->stats.l2_requests++;
+    core->delay += start - at + latency;
+}
+
+
+/**
+ * The cores' requests that reach the L2 before until, in the order they
+ * do: each core's in its own order, its later ones pushed back by the
+ * delays of its earlier ones. Later ones wait for the next weave, so the
+ * L2 sees every request in time order even when a core ran ahead.
+*/
+static void weave(Multicore* mc, double until) {
+    size_t next[MAX_CORES] = { 0 };
+
+    while (1) {
+        int first = -1;
+        double first_at = 0;
+        for (int c = 0; c < mc->num_cores; c++) {
+            Core* core = &mc->cores[c];
+            if (next[c] < core->num_requests) {
+                double at = core->requests[next[c]].time + core->delay;
+                if (first < 0 || at < first_at) {
+                    first = c;
+                    first_at = at;
+                }
+            }
+        }
+        if (first < 0 || first_at >= until) {
+            break;
+        }
+        weave_request(mc, first, &mc->cores[first].requests[next[first]++]);
+    }
+
+    for (int c = 0; c < mc->num_cores; c++) {
+        Core* core = &mc->cores[c];
+        core->num_requests -= next[c];
+        memmove(core->requests, core->requests + next[c], core->num_requests * sizeof(CoherenceRequest));
+    }
+}
+
+
+/**
+ * Run every core to the end of its trace, an epoch at a time: the cores
+ * run their private L1s in parallel up to the epoch's end, then the main
+ * thread weaves what they sent the L2
+*/
+static void run_multicore(Multicore* mc) {
+    Worker workers[MAX_CORES];
+    pthread_t threads[MAX_CORES];
+    pthread_barrier_init(&mc->start, NULL, mc->num_threads);
+    pthread_barrier_init(&mc->finish, NULL, mc->num_threads);
+    for (int t = 1; t < mc->num_threads; t++) {
+        workers[t] = (Worker) { mc, t };
+        if (pthread_create(&threads[t], NULL, worker_main, &workers[t]) != 0) {
+            fprintf(stderr, "Error: Unable to start core thread %d\n", t);
+            exit(1);
+        }
+    }
+
+    double start = now_seconds();
+    int running = 1;
+    while (running) {
+        mc->epoch_end += mc->epoch;
+        mc->epochs++;
+
+        pthread_barrier_wait(&mc->start);
+        for (int c = 0; c < mc->num_cores; c += mc->num_threads) {
+            core_run(&mc->cores[c], mc->epoch_end);
+        }
+        pthread_barrier_wait(&mc->finish);
+
+        running = 0;
+        for (int c = 0; c < mc->num_cores; c++) {
+            running |= !mc->cores[c].done;
+        }
+        weave(mc, running ? mc->epoch_end : INFINITY);
+    }
+    mc->seconds = now_seconds() - start;
+
+    mc->stop = 1;
+    pthread_barrier_wait(&mc->start);
+    for (int t = 1; t < mc->num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_barrier_destroy(&mc->start);
+    pthread_barrier_destroy(&mc->finish);
+}
+
+
+/**
+ * Print what each core and the shared levels did
+*/
+static void print_multicore(const Multicore* mc) {
+    const CacheStats* shared = &mc->shared->stats;
+    unsigned long int records = 0;
+    double elapsed = 0;
+
+    printf("\nMulticore Statistics:\n");
+    for (int c = 0; c < mc->num_cores; c++) {
+        printf("Core %d: %s\n", c, mc->cores[c].trace);
+    }
+    printf("\n");
+    printf("Core | # Records   | L1i Misses  | L1d Misses  | L2 Hits     | L2 Misses   | Upgrades    | Write Backs | Invalidations | Coherence Misses | Avg L2 Wait (ns) | Access Time\n");
+    printf("-----|-------------|-------------|-------------|-------------|-------------|-------------|-------------|---------------|------------------|------------------|------------\n");
+    for (int c = 0; c < mc->num_cores; c++) {
+        const Core* core = &mc->cores[c];
+        const CoreStats* s = &core->stats;
+        double clock = core->clock + core->delay;
+        printf("%-4d | %-11lu | %-11lu | %-11lu | %-11lu | %-11lu | %-11lu | %-11lu | %-13lu | %-16lu | %-16.2f | %.2f\n",
+            c, s->records, s->l1i_misses, s->l1d_misses, s->l2_hits, s->l2_misses, s->upgrades, s->write_backs,
+            s->invalidations, s->coherence_misses, s->l2_requests ? s->l2_wait / s->l2_requests : 0, clock);
+        records += s->records;
+        if (clock > elapsed) {
+            elapsed = clock;
+        }
+    }
+    printf("\n");
+
+    printf("Shared Levels:\n");
+    printf("Component | # Hits      | # Misses\n");
+    printf("----------|-------------|------------\n");
+    printf("L2        | %-9lu   | %lu\n", shared->l2_hits, shared->l2_misses);
+    if (mc->shared->has_l3) {
+        printf("L3        | %-9lu   | %lu\n", shared->l3_hits, shared->l3_misses);
+    }
+    printf("DRAM      | %-9lu   | N/A\n", shared->dram_hits);
+    printf("\n");
+
+    printf("%d cores, %lu records in %.2f ns simulated, %lu epochs of %.0f ns\n",
+        mc->num_cores, records, elapsed, mc->epochs, mc->epoch);
+    printf("%d host threads in %.3f s, %.2f M refs/s\n\n", mc->num_threads, mc->seconds,
+        mc->seconds > 0 ? records / mc->seconds / 1e6 : 0);
+}
+
+
+/**
+ * One trace per core, private L1s, a shared L2 (and L3), MESI between the L1s
+ * multicore <-j threads> <--epoch=ns> <--config=file> <--key=value> <core0.din> <core1.din> ...
+*/
+int multicore_main(int argc, char* argv[]) {
+    static Multicore mc;
+    int reader_kind = READER_MMAP;
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    CacheConfig config;
+    default_config(&config);
+    mc.epoch = DEFAULT_EPOCH;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "--epoch=", 8) == 0) {
+            mc.epoch = strtod(argv[i] + 8, NULL);
+            if (!(mc.epoch > 0)) {
+                fprintf(stderr, "Invalid epoch, expected ns above 0\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--reader=", 9) == 0) {
+            reader_kind = trace_parse_reader(argv[i] + 9);
+            if (reader_kind < 0) {
+                fprintf(stderr, "Invalid reader, expected stdio or mmap\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--config=", 9) == 0) {
+            if (load_config_file(argv[i] + 9, &config) != 0) {
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0 && strchr(argv[i], '=')) {
+            const char* value = strchr(argv[i], '=') + 1;
+            char key[CONFIG_MAX_LINE];
+            snprintf(key, sizeof(key), "%.*s", (int) (value - argv[i] - 3), argv[i] + 2);
+            if (set_config_key(&config, key, value) != 0) {
+                fprintf(stderr, "Invalid option %s\n", argv[i]);
+                return 1;
+            }
+        } else if (mc.num_cores < MAX_CORES) {
+            mc.cores[mc.num_cores++].trace = argv[i];
+        } else {
+            fprintf(stderr, "Too many cores, at most %d\n", MAX_CORES);
+            return 1;
+        }
+    }
+
+    if (mc.num_cores == 0) {
+        fprintf(stderr, "Usage: %s multicore <-j threads> <--epoch=ns> <--config=file> <--LEVEL-size=S> ... <core0.din> <core1.din> ...\n", argv[0]);
+        return 1;
+    }
+
+    char error[CONFIG_MAX_LINE];
+    if (check_config(&config, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Invalid configuration: %s\n", error);
+        return 1;
+    }
+    if (config.l1d.prefetch != PREFETCH_NONE || config.issue_window) {
+        fprintf(stderr, "Invalid configuration: multicore runs without an L1 dcache prefetcher or an issue window\n");
+        return 1;
+    }
+
+    // coherence keeps no payloads
+    config.tags_only = 1;
+    mc.shared = create_simulator(&config);
+    for (int c = 0; c < mc.num_cores; c++) {
+        Core* core = &mc.cores[c];
+        if (trace_open(&core->reader, core->trace, reader_kind) != 0) {
+            fprintf(stderr, "Error: Unable to open %s. Is it in Dinero 3 .din format?\n", core->trace);
+            return 1;
+        }
+        private_init(&core->l1i, &config, &config.l1i);
+        private_init(&core->l1d, &config, &config.l1d);
+    }
+    mc.num_threads = num_threads < 1 ? 1 : num_threads > mc.num_cores ? mc.num_cores : num_threads;
+
+    printf("Running %d cores on %d threads ...\n", mc.num_cores, mc.num_threads);
+    run_multicore(&mc);
+
+    for (int c = 0; c < mc.num_cores; c++) {
+        Core* core = &mc.cores[c];
+        if (core->status == RUN_MALFORMED) {
+            fprintf(stderr, "Error: Malformed trace record on line %lu of %s.\n", core->reader.line, core->trace);
+            return 1;
+        }
+        if (core->status == RUN_INVALID_OP) {
+            fprintf(stderr, "Error: Invalid operation code or arguments in %s: %c 0x%lx 0x%lx\n", core->trace,
+                core->record.operation, core->record.address, core->record.value);
+            return 1;
+        }
+    }
+    printf("Simulation Complete.\n");
+    print_multicore(&mc);
+
+    for (int c = 0; c < mc.num_cores; c++) {
+        Core* core = &mc.cores[c];
+        trace_close(&core->reader);
+        private_free(&core->l1i);
+        private_free(&core->l1d);
+        free(core->requests);
+    }
+    free(mc.directory.entries);
+    destroy_simulator(mc.shared);
+    return 0;
+}
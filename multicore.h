@@ -0,0 +1,112 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <pthread.h>
+
+#include "./cache_simulator.h"
+
+// most cores of one multicore run, a directory entry keeps one bit per core
+#define MAX_CORES 64
+
+// simulated ns the cores run between two synchronizations, set with --epoch
+#define DEFAULT_EPOCH 1000.0
+
+// directory entries to start with, doubled whenever half are used
+#define DIRECTORY_INITIAL_SIZE 4096
+
+// what a private L1 asks of the shared L2 and the directory
+#define REQ_GETS    0   // read miss
+#define REQ_GETM    1   // write miss
+#define REQ_UPGRADE 2   // write hit on a shared line
+#define REQ_PUTM    3   // a modified line evicted, written back
+#define REQ_PUTS    4   // a clean line evicted
+
+typedef struct {
+    double time;                // the core's clock when it asked, without earlier weave delays
+    unsigned long int block;
+    int type;
+    int l1;                     // INSTR_FETCH for the L1 icache, else the L1 dcache
+} CoherenceRequest;
+
+// one private L1, MESI state in the level's bits: invalid lines aren't valid,
+// modified ones are dirty, clean ones exclusive or shared
+typedef struct {
+    CacheLevel level;
+    unsigned long int* blocks;  // block held in each entry
+    uint64_t* exclusive;        // a bit per entry
+} PrivateCache;
+
+// what one core did
+typedef struct {
+    unsigned long int records;
+    unsigned long int l1i_hits;
+    unsigned long int l1i_misses;
+    unsigned long int l1d_hits;
+    unsigned long int l1d_misses;
+    unsigned long int upgrades;         // writes to shared lines
+    unsigned long int write_backs;      // modified lines evicted or taken by another core
+    unsigned long int l2_hits;          // of its GETS and GETM
+    unsigned long int l2_misses;
+    unsigned long int invalidations;    // its lines invalidated by other cores' writes
+    unsigned long int coherence_misses; // misses to blocks another core's write invalidated
+    double l2_wait;                     // ns its requests waited for the shared L2
+    unsigned long int l2_requests;
+} CoreStats;
+
+typedef struct {
+    const char* trace;
+    TraceReader reader;
+    int done;
+    int status;                 // RUN_* once done
+    TraceRecord record;         // the invalid record for RUN_INVALID_OP
+
+    PrivateCache l1i;
+    PrivateCache l1d;
+
+    double clock;               // L1 time of every access run
+    double delay;               // what the weaves added: L2, DRAM and waiting
+
+    CoherenceRequest* requests; // this epoch's, in order
+    size_t num_requests;
+    size_t capacity;
+
+    CoreStats stats;
+} Core;
+
+// sharers of one block, owner is the core holding it exclusive or modified
+typedef struct {
+    unsigned long int block;
+    uint64_t sharers;
+    uint64_t invalidated;       // cores that lost it to a write since they last missed on it
+    int owner;
+    int used;
+} DirectoryEntry;
+
+typedef struct {
+    DirectoryEntry* entries;
+    size_t size;
+    size_t used;
+} Directory;
+
+typedef struct {
+    Core cores[MAX_CORES];
+    int num_cores;
+    CacheSim* shared;           // its L2, L3 and DRAM serve every core
+    Directory directory;
+    double l2_free;             // when the shared L2 takes the next request
+
+    double epoch;
+    double epoch_end;
+    unsigned long int epochs;
+
+    // host threads: each runs cores t, t + threads, ... between two barriers
+    int num_threads;
+    int stop;
+    pthread_barrier_t start;
+    pthread_barrier_t finish;
+    double seconds;
+} Multicore;
+
+int multicore_main(int argc, char* argv[]);
+
+#endif
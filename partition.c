@@ -0,0 +1,280 @@
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+
+#include "./partition.h"
+#include "./wall_clock.h"
+
+
+// one worker thread and the slice of every configuration it owns
+typedef struct {
+    RecordRing ring;
+    CacheSim* sims[MAX_SWEEP_CONFIGS];
+    size_t num_sims;
+
+    // reader side
+    size_t pending;             // records written past the ring head, not yet published
+    size_t room;                // free contiguous slots after those
+
+    // worker side
+    unsigned long int records;
+    double busy;
+    double stall;
+} Partition;
+
+
+/**
+ * Address bit the partition number starts at: the lowest set index bit of
+ * the largest block size, so it is a set index bit of every level.
+*/
+unsigned int partition_shift(const CacheConfig* configs, size_t num_configs) {
+    unsigned int shift = 0;
+    for (size_t i = 0; i < num_configs; i++) {
+        unsigned int block_shift = __builtin_ctzl(configs[i].block_size);
+        if (block_shift > shift) {
+            shift = block_shift;
+        }
+    }
+    return shift;
+}
+
+
+/**
+ * Address inside a partition: the partition bits cut out, so each level's
+ * set index loses them and the tag stays the same
+*/
+unsigned long int partition_address(unsigned long int address, unsigned int shift, unsigned int bits) {
+    return ((address >> (shift + bits)) << shift) | (address & ((1UL << shift) - 1));
+}
+
+
+/**
+ * Shrink a configuration to one partition's slice, 1/partitions of every level
+*/
+void partition_config(CacheConfig* config, int partitions) {
+    config->l1i.size /= partitions;
+    config->l1d.size /= partitions;
+    config->l2.size /= partitions;
+    config->l3.size /= partitions;
+}
+
+
+/**
+ * Check the partition bits fall inside one level's set index
+*/
+static int check_level(const CacheConfig* config, const LevelConfig* level, const char* name,
+                       unsigned int shift, unsigned int bits, char* error, size_t error_size) {
+    unsigned long int sets = level_num_sets(config, level);
+    if ((sets & (sets - 1)) != 0) {
+        snprintf(error, error_size, "%s has %lu sets, not a power of two", name, sets);
+        return -1;
+    }
+    unsigned int block_shift = __builtin_ctzl(config->block_size);
+    if (shift - block_shift + bits > (unsigned int) __builtin_ctzl(sets)) {
+        snprintf(error, error_size, "%s has too few sets (%lu) for %d partitions", name, sets, 1 << bits);
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Check every configuration can be split into partitions by set.
+ * Returns 0 if so, -1 with the reason in error if not.
+*/
+int check_partitions(const CacheConfig* configs, size_t num_configs, int partitions, char* error, size_t error_size) {
+    if (partitions < 1 || partitions > MAX_PARTITIONS || (partitions & (partitions - 1)) != 0) {
+        snprintf(error, error_size, "%d partitions isn't a power of two from 1 to %d", partitions, MAX_PARTITIONS);
+        return -1;
+    }
+
+    unsigned int shift = partition_shift(configs, num_configs);
+    unsigned int bits = __builtin_ctz(partitions);
+    for (size_t i = 0; i < num_configs; i++) {
+        const CacheConfig* config = &configs[i];
+        if (config->issue_window) {
+            snprintf(error, error_size, "the non-blocking timing model (issue-window) overlaps misses across every set");
+            return -1;
+        }
+        if (config->classify) {
+            snprintf(error, error_size, "the fully associative shadows of --classify-misses span every set");
+            return -1;
+        }
+        if (config->l1d.prefetch != PREFETCH_NONE || config->l2.prefetch != PREFETCH_NONE) {
+            snprintf(error, error_size, "prefetchers predict neighbouring blocks, which fall in other partitions");
+            return -1;
+        }
+        if (check_level(config, &config->l1i, "L1 icache", shift, bits, error, error_size) != 0
+            || check_level(config, &config->l1d, "L1 dcache", shift, bits, error, error_size) != 0
+            || check_level(config, &config->l2, "L2", shift, bits, error, error_size) != 0) {
+            return -1;
+        }
+        if (config->l3.size && check_level(config, &config->l3, "L3", shift, bits, error, error_size) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Worker thread: simulate its partition's records on its slices
+*/
+static void* partition_main(void* arg) {
+    Partition* partition = arg;
+    RecordRing* ring = &partition->ring;
+    double start = now_seconds();
+
+    size_t count;
+    while ((count = ring_wait_records(ring, &partition->stall)) > 0) {
+        if (count > PIPELINE_BATCH_SIZE) {
+            count = PIPELINE_BATCH_SIZE;
+        }
+
+        // the reader only dispatches valid records
+        const TraceRecord* batch = ring_tail_slot(ring);
+        for (size_t i = 0; i < partition->num_sims; i++) {
+            simulate_records(partition->sims[i], batch, count);
+        }
+        partition->records += count;
+        ring_release(ring, count);
+    }
+
+    partition->busy = now_seconds() - start - partition->stall;
+    return NULL;
+}
+
+
+/**
+ * Publish the records collected for a partition
+*/
+static void flush_partition(Partition* partition) {
+    ring_publish(&partition->ring, partition->pending);
+    partition->pending = 0;
+}
+
+
+/**
+ * Run a trace through every simulator with the sets split across threads.
+ * Each partition owns every set whose index has its number in the
+ * partition bits, in every level of every configuration, so the threads
+ * never share state. The slices' stats are added into sims at the end.
+*/
+RunResult run_partitioned_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                                int partitions, PartitionStats* stats) {
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+    memset(stats, 0, sizeof(*stats));
+    stats->num_partitions = partitions;
+    double start = now_seconds();
+
+    TraceReader reader;
+    if (trace_open(&reader, filename, reader_kind) != 0) {
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+
+    CacheConfig configs[MAX_SWEEP_CONFIGS];
+    for (size_t i = 0; i < num_sims; i++) {
+        configs[i] = sims[i]->config;
+    }
+    unsigned int shift = partition_shift(configs, num_sims);
+    unsigned int bits = __builtin_ctz(partitions);
+
+    for (size_t i = 0; i < num_sims; i++) {
+        partition_config(&configs[i], partitions);
+    }
+
+    Partition* parts = calloc(partitions, sizeof(Partition));
+    pthread_t* threads = malloc(partitions * sizeof(pthread_t));
+    if (!parts || !threads) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    for (int p = 0; p < partitions; p++) {
+        ring_init(&parts[p].ring);
+        parts[p].num_sims = num_sims;
+        for (size_t i = 0; i < num_sims; i++) {
+            parts[p].sims[i] = create_simulator(&configs[i]);
+        }
+        if (pthread_create(&threads[p], NULL, partition_main, &parts[p]) != 0) {
+            fprintf(stderr, "Error: Unable to start partition thread %d\n", p);
+            exit(1);
+        }
+    }
+
+    // decode and deal every record to the partition owning its sets
+    TraceRecord record;
+    int status;
+    while ((status = trace_next(&reader, &record)) == TRACE_RECORD) {
+        if (!record_valid(&record)) {
+            result.status = RUN_INVALID_OP;
+            result.record = record;
+            break;
+        }
+
+        Partition* partition = &parts[(record.address >> shift) & (partitions - 1)];
+        record.address = partition_address(record.address, shift, bits);
+
+        if (partition->room == 0) {
+            flush_partition(partition);
+            partition->room = ring_wait_room(&partition->ring, &stats->reader_stall);
+        }
+        ring_head_slot(&partition->ring)[partition->pending++] = record;
+        partition->room--;
+        if (partition->pending == PARTITION_PUBLISH_SIZE) {
+            flush_partition(partition);
+        }
+        result.records++;
+    }
+    stats->reader_busy = now_seconds() - start - stats->reader_stall;
+
+    for (int p = 0; p < partitions; p++) {
+        flush_partition(&parts[p]);
+        ring_finish(&parts[p].ring);
+    }
+
+    // merge the slices
+    for (int p = 0; p < partitions; p++) {
+        pthread_join(threads[p], NULL);
+        for (size_t i = 0; i < num_sims; i++) {
+            add_stats(&sims[i]->stats, &parts[p].sims[i]->stats);
+            destroy_simulator(parts[p].sims[i]);
+        }
+        ring_free(&parts[p].ring);
+
+        stats->records[p] = parts[p].records;
+        stats->busy[p] = parts[p].busy;
+        stats->stall[p] = parts[p].stall;
+    }
+
+    if (result.status == RUN_OK && status == TRACE_MALFORMED) {
+        result.status = RUN_MALFORMED;
+        result.line = reader.line;
+    }
+
+    stats->seconds = now_seconds() - start;
+
+    free(threads);
+    free(parts);
+    trace_close(&reader);
+    return result;
+}
+
+
+/**
+ * Print how the records spread over the partitions and where each thread waited
+*/
+void print_partition_stats(const PartitionStats* stats) {
+    unsigned long int total = 0;
+
+    printf("Partition Statistics:\n");
+    printf("Partition | Records     | Busy (s)    | Stalled (s)\n");
+    printf("----------|-------------|-------------|------------\n");
+    for (int p = 0; p < stats->num_partitions; p++) {
+        printf("%-9d | %-11lu | %-11.3f | %.3f\n", p, stats->records[p], stats->busy[p], stats->stall[p]);
+        total += stats->records[p];
+    }
+    printf("Reader    | %-11lu | %-11.3f | %.3f\n", total, stats->reader_busy, stats->reader_stall);
+    printf("%d partitions in %.3f s\n\n", stats->num_partitions, stats->seconds);
+}
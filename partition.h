@@ -0,0 +1,32 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "./cache_simulator.h"
+#include "./pipeline.h"
+
+// most worker threads of one partitioned run
+#define MAX_PARTITIONS 64
+
+// records the reader collects for a partition before publishing them
+#define PARTITION_PUBLISH_SIZE 256
+
+// where the reader and each partition spent their time
+typedef struct {
+    int num_partitions;
+    unsigned long int records[MAX_PARTITIONS];
+    double busy[MAX_PARTITIONS];        // seconds simulating
+    double stall[MAX_PARTITIONS];       // seconds waiting on an empty ring
+    double reader_busy;                 // seconds decoding and dispatching
+    double reader_stall;                // seconds waiting on a full ring
+    double seconds;                     // wall clock of the whole run
+} PartitionStats;
+
+unsigned int partition_shift(const CacheConfig* configs, size_t num_configs);
+unsigned long int partition_address(unsigned long int address, unsigned int shift, unsigned int bits);
+void partition_config(CacheConfig* config, int partitions);
+int check_partitions(const CacheConfig* configs, size_t num_configs, int partitions, char* error, size_t error_size);
+RunResult run_partitioned_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                                int partitions, PartitionStats* stats);
+void print_partition_stats(const PartitionStats* stats);
+
+#endif
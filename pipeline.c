@@ -0,0 +1,242 @@
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "./pipeline.h"
+#include "./wall_clock.h"
+
+
+// the reader thread of run_pipelined_trace
+typedef struct {
+    RecordRing ring;
+    TraceReader* reader;
+    int status;                 // trace_next result that ended the reader
+    double busy;
+    double stall;
+} Pipeline;
+
+
+/**
+ * Empty ring
+*/
+void ring_init(RecordRing* ring) {
+    memset(ring, 0, sizeof(*ring));
+    ring->records = malloc(PIPELINE_RING_SIZE * sizeof(TraceRecord));
+    if (!ring->records) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+}
+
+
+/**
+ * Free a ring
+*/
+void ring_free(RecordRing* ring) {
+    free(ring->records);
+    ring->records = NULL;
+}
+
+
+/**
+ * Free slots from ring_head_slot up to the end of the buffer, waiting while the ring is full.
+ * Adds the wait to stall. Returns 0 if the consumer stopped instead.
+*/
+size_t ring_wait_room(RecordRing* ring, double* stall) {
+    size_t room = PIPELINE_RING_SIZE - (ring->head - ring->cached_tail);
+    if (room == 0) {
+        double start = now_seconds();
+        while (room == 0 && !__atomic_load_n(&ring->stop, __ATOMIC_RELAXED)) {
+            ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+            room = PIPELINE_RING_SIZE - (ring->head - ring->cached_tail);
+            if (room == 0) {
+                sched_yield();
+            }
+        }
+        *stall += now_seconds() - start;
+    }
+
+    size_t contiguous = PIPELINE_RING_SIZE - (ring->head & (PIPELINE_RING_SIZE - 1));
+    return room < contiguous ? room : contiguous;
+}
+
+
+/**
+ * Hand count records written from ring_head_slot on to the consumer
+*/
+void ring_publish(RecordRing* ring, size_t count) {
+    __atomic_store_n(&ring->head, ring->head + count, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Tell the consumer nothing more is coming
+*/
+void ring_finish(RecordRing* ring) {
+    __atomic_store_n(&ring->done, 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Records from ring_tail_slot up to the end of the buffer, waiting while the ring is empty.
+ * Adds the wait to stall. Returns 0 once the producer is done and everything it published is consumed.
+*/
+size_t ring_wait_records(RecordRing* ring, double* stall) {
+    size_t ready = ring->cached_head - ring->tail;
+    if (ready == 0) {
+        double start = now_seconds();
+        for (;;) {
+            // done first, so a head read after it has everything the producer published
+            int done = __atomic_load_n(&ring->done, __ATOMIC_ACQUIRE);
+            ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            ready = ring->cached_head - ring->tail;
+            if (ready > 0 || done) {
+                break;
+            }
+            sched_yield();
+        }
+        *stall += now_seconds() - start;
+    }
+
+    size_t contiguous = PIPELINE_RING_SIZE - (ring->tail & (PIPELINE_RING_SIZE - 1));
+    return ready < contiguous ? ready : contiguous;
+}
+
+
+/**
+ * Give count consumed records' slots back to the producer
+*/
+void ring_release(RecordRing* ring, size_t count) {
+    __atomic_store_n(&ring->tail, ring->tail + count, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Tell the producer to stop filling the ring
+*/
+void ring_stop(RecordRing* ring) {
+    __atomic_store_n(&ring->stop, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Reader thread: decode records straight into the ring and publish them a batch at a time
+*/
+static void* reader_main(void* arg) {
+    Pipeline* pipeline = arg;
+    RecordRing* ring = &pipeline->ring;
+    double start = now_seconds();
+    int status = TRACE_RECORD;
+
+    while (status == TRACE_RECORD) {
+        size_t count = ring_wait_room(ring, &pipeline->stall);
+        if (count == 0) {
+            break;
+        }
+        if (count > PIPELINE_BATCH_SIZE) {
+            count = PIPELINE_BATCH_SIZE;
+        }
+
+        TraceRecord* slots = ring_head_slot(ring);
+        size_t decoded = 0;
+        while (decoded < count && (status = trace_next(pipeline->reader, &slots[decoded])) == TRACE_RECORD) {
+            decoded++;
+        }
+        ring_publish(ring, decoded);
+    }
+
+    pipeline->status = status;
+    pipeline->busy = now_seconds() - start - pipeline->stall;
+    ring_finish(ring);
+    return NULL;
+}
+
+
+/**
+ * Run a trace through every simulator with decoding on its own thread.
+ * Same results as run_dinero_trace, plus where each stage spent its time.
+*/
+RunResult run_pipelined_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                              PipelineStats* stats) {
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+    memset(stats, 0, sizeof(*stats));
+    double start = now_seconds();
+
+    TraceReader reader;
+    if (trace_open(&reader, filename, reader_kind) != 0) {
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.reader = &reader;
+    ring_init(&pipeline.ring);
+    RecordRing* ring = &pipeline.ring;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, reader_main, &pipeline) != 0) {
+        fprintf(stderr, "Error: Unable to start the reader thread\n");
+        exit(1);
+    }
+
+    double simulator_stall = 0.0;
+    size_t count;
+    while (result.status == RUN_OK && (count = ring_wait_records(ring, &simulator_stall)) > 0) {
+        if (count > PIPELINE_BATCH_SIZE) {
+            count = PIPELINE_BATCH_SIZE;
+        }
+
+        const TraceRecord* batch = ring_tail_slot(ring);
+        for (size_t i = 0; i < num_sims && result.status == RUN_OK; i++) {
+            size_t done = simulate_records(sims[i], batch, count);
+            if (done < count) {
+                result.status = RUN_INVALID_OP;
+                result.record = batch[done];
+            }
+        }
+        result.records += count;
+        ring_release(ring, count);
+    }
+
+    if (result.status != RUN_OK) {
+        ring_stop(ring);
+    }
+    pthread_join(thread, NULL);
+
+    if (result.status == RUN_OK && pipeline.status == TRACE_MALFORMED) {
+        result.status = RUN_MALFORMED;
+        result.line = reader.line;
+    }
+
+    stats->seconds = now_seconds() - start;
+    stats->records = result.records;
+    stats->reader_busy = pipeline.busy;
+    stats->reader_stall = pipeline.stall;
+    stats->simulator_stall = simulator_stall;
+    stats->simulator_busy = stats->seconds - simulator_stall;
+
+    ring_free(ring);
+    trace_close(&reader);
+    return result;
+}
+
+
+/**
+ * Print per-stage throughput and stall time.
+ * The stage that waits least is the one holding the other back.
+*/
+void print_pipeline_stats(const PipelineStats* stats) {
+    double reader_rate = stats->reader_busy > 0 ? stats->records / stats->reader_busy : 0.0;
+    double simulator_rate = stats->simulator_busy > 0 ? stats->records / stats->simulator_busy : 0.0;
+
+    printf("Pipeline Statistics:\n");
+    printf("Stage     | Busy (s)    | Stalled (s) | Records/s (busy)\n");
+    printf("----------|-------------|-------------|-----------------\n");
+    printf("Reader    | %-11.3f | %-11.3f | %.0f\n", stats->reader_busy, stats->reader_stall, reader_rate);
+    printf("Simulator | %-11.3f | %-11.3f | %.0f\n", stats->simulator_busy, stats->simulator_stall, simulator_rate);
+    printf("%lu records in %.3f s, bottleneck: %s\n\n", stats->records, stats->seconds,
+        stats->reader_stall < stats->simulator_stall ? "reader" : "simulator");
+}
@@ -0,0 +1,64 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "./cache_simulator.h"
+
+// records in flight between the reader and the simulator, a power of two
+#define PIPELINE_RING_SIZE (16 * SWEEP_BATCH_SIZE)
+
+// most records one stage moves per turn
+#define PIPELINE_BATCH_SIZE SWEEP_BATCH_SIZE
+
+// keeps the producer's and the consumer's indices off each other's cache line
+#define CACHE_LINE 64
+
+// lock-free ring of records from one producer thread to one consumer thread
+// head only moves on the producer, tail only on the consumer, both count
+// records forever and are masked into the ring
+typedef struct {
+    TraceRecord* records;
+
+    // producer side
+    __attribute__((aligned(CACHE_LINE))) unsigned long int head;
+    unsigned long int cached_tail;      // last tail the producer saw
+    int done;                           // set once the producer won't publish more
+
+    // consumer side
+    __attribute__((aligned(CACHE_LINE))) unsigned long int tail;
+    unsigned long int cached_head;      // last head the consumer saw
+    int stop;                           // set when the consumer gives up early
+} RecordRing;
+
+// where each stage spent its time
+typedef struct {
+    unsigned long int records;
+    double reader_busy;         // seconds decoding
+    double reader_stall;        // seconds waiting on a full ring
+    double simulator_busy;      // seconds simulating
+    double simulator_stall;     // seconds waiting on an empty ring
+    double seconds;             // wall clock of the whole run
+} PipelineStats;
+
+void ring_init(RecordRing* ring);
+void ring_free(RecordRing* ring);
+size_t ring_wait_room(RecordRing* ring, double* stall);
+void ring_publish(RecordRing* ring, size_t count);
+void ring_finish(RecordRing* ring);
+size_t ring_wait_records(RecordRing* ring, double* stall);
+void ring_release(RecordRing* ring, size_t count);
+void ring_stop(RecordRing* ring);
+
+// next free slot for the producer, next record for the consumer
+static inline TraceRecord* ring_head_slot(RecordRing* ring) {
+    return &ring->records[ring->head & (PIPELINE_RING_SIZE - 1)];
+}
+
+static inline const TraceRecord* ring_tail_slot(const RecordRing* ring) {
+    return &ring->records[ring->tail & (PIPELINE_RING_SIZE - 1)];
+}
+
+RunResult run_pipelined_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                              PipelineStats* stats);
+void print_pipeline_stats(const PipelineStats* stats);
+
+#endif
@@ -0,0 +1,173 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+
+#include "./prefetch.h"
+
+
+static const char* PREFETCH_NAMES[NUM_PREFETCHERS] = { "none", "next-line", "stride", "stream" };
+
+
+/**
+ * Map a prefetcher name to its PREFETCH_* kind, -1 if unknown
+*/
+int prefetch_parse(const char* name) {
+    for (int kind = 0; kind < NUM_PREFETCHERS; kind++) {
+        if (strcmp(name, PREFETCH_NAMES[kind]) == 0) {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Name of a prefetcher
+*/
+const char* prefetch_name(int kind) {
+    return kind >= 0 && kind < NUM_PREFETCHERS ? PREFETCH_NAMES[kind] : "unknown";
+}
+
+
+/**
+ * Forget everything a prefetcher learned
+*/
+void prefetch_reset(Prefetcher* prefetcher, int kind, int degree) {
+    memset(prefetcher, 0, sizeof(*prefetcher));
+    prefetcher->kind = kind;
+    prefetcher->degree = degree;
+}
+
+
+/**
+ * Train on a demand access to block and pick the blocks to fetch into the
+ * level. trigger is set for a miss or the first hit on a prefetched block,
+ * which is when next-line runs; stride trains on every access. Stream
+ * buffers sit beside the level and are driven with stream_take instead.
+ * Returns how many blocks it put in blocks (at most the degree).
+*/
+size_t prefetch_candidates(Prefetcher* prefetcher, unsigned long int block, int trigger, unsigned long int* blocks) {
+    size_t count = 0;
+
+    if (prefetcher->kind == PREFETCH_NEXT_LINE && trigger) {
+        for (int k = 1; k <= prefetcher->degree; k++) {
+            blocks[count++] = block + k;
+        }
+    }
+
+    if (prefetcher->kind == PREFETCH_STRIDE) {
+        unsigned long int region = block / STRIDE_REGION_BLOCKS;
+        StrideEntry* entry = &prefetcher->strides[region % STRIDE_TABLE_SIZE];
+        if (!entry->valid || entry->region != region) {
+            *entry = (StrideEntry) { region, block, 0, 0, 1 };
+            return 0;
+        }
+
+        long int stride = (long int) (block - entry->last_block);
+        if (stride == 0) {
+            return 0;
+        }
+        if (stride == entry->stride) {
+            if (entry->confidence < STRIDE_MAX_CONFIDENCE) {
+                entry->confidence++;
+            }
+        } else if (entry->confidence > 0) {
+            entry->confidence--;
+        } else {
+            entry->stride = stride;
+        }
+        entry->last_block = block;
+
+        if (entry->confidence >= STRIDE_CONFIDENT) {
+            for (int k = 1; k <= prefetcher->degree; k++) {
+                blocks[count++] = block + k * entry->stride;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+/**
+ * Look for block at the head of a stream buffer and pop it.
+ * Returns 1 with the fill's arrival in ready if a stream had it.
+*/
+int stream_take(Prefetcher* prefetcher, unsigned long int block, double* ready) {
+    for (int i = 0; i < STREAM_BUFFERS; i++) {
+        StreamBuffer* stream = &prefetcher->streams[i];
+        if (stream->count > 0 && stream->head == block) {
+            *ready = stream->ready[stream->first];
+            stream->head++;
+            stream->first = (stream->first + 1) % MAX_PREFETCH_DEGREE;
+            stream->count--;
+            stream->last_used = ++prefetcher->uses;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Stream buffer continuing at head: the one a stream_take just advanced
+ * there, else the least recently used one restarted at head. The blocks a
+ * restarted stream held are dropped unused and counted in dropped.
+*/
+StreamBuffer* stream_for(Prefetcher* prefetcher, unsigned long int head, unsigned long int* dropped) {
+    StreamBuffer* victim = &prefetcher->streams[0];
+    for (int i = 0; i < STREAM_BUFFERS; i++) {
+        StreamBuffer* stream = &prefetcher->streams[i];
+        if (stream->last_used > 0 && stream->head == head) {
+            return stream;
+        }
+        if (stream->last_used < victim->last_used) {
+            victim = stream;
+        }
+    }
+
+    *dropped += victim->count;
+    memset(victim, 0, sizeof(*victim));
+    victim->head = head;
+    victim->last_used = ++prefetcher->uses;
+    return victim;
+}
+
+
+/**
+ * Block the stream fetches next
+*/
+unsigned long int stream_next_block(const StreamBuffer* stream) {
+    return stream->head + stream->count;
+}
+
+
+/**
+ * Queue the fill of stream_next_block
+*/
+void stream_append(StreamBuffer* stream, double ready) {
+    stream->ready[(stream->first + stream->count) % MAX_PREFETCH_DEGREE] = ready;
+    stream->count++;
+}
+
+
+/**
+ * Add one level's prefetch counters into another's
+*/
+void add_prefetch_stats(PrefetchStats* total, const PrefetchStats* stats) {
+    total->issued += stats->issued;
+    total->useful += stats->useful;
+    total->late += stats->late;
+    total->useless += stats->useless;
+    total->misses += stats->misses;
+    total->dram_reads += stats->dram_reads;
+}
+
+
+/**
+ * Energy of the DRAM reads the prefetches caused: active and static energy
+ * per read (the idle energy they add to the other parts is left out)
+*/
+double prefetch_dram_energy(const PrefetchStats* stats, const EnergyModel* model) {
+    return stats->dram_reads * (model->active[PART_DRAM] + model->dram_static_per_read);
+}
@@ -0,0 +1,77 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+
+#include "./energy.h"
+
+// prefetchers, set per level with l1d-prefetch and l2-prefetch
+#define PREFETCH_NONE      0
+#define PREFETCH_NEXT_LINE 1    // the next degree blocks on a miss or a first hit on a prefetched block
+#define PREFETCH_STRIDE    2    // per region stride detection on the address stream, no PCs
+#define PREFETCH_STREAM    3    // Jouppi stream buffers next to the level
+#define NUM_PREFETCHERS    4
+
+// blocks fetched ahead, set with prefetch-degree
+#define PREFETCH_DEGREE     2
+#define MAX_PREFETCH_DEGREE 16
+
+// stride detector: direct mapped table of regions (4KB of 64 byte blocks),
+// issues at 2 of 3 confidence
+#define STRIDE_TABLE_SIZE   64
+#define STRIDE_REGION_BLOCKS 64
+#define STRIDE_CONFIDENT    2
+#define STRIDE_MAX_CONFIDENCE 3
+
+// stream buffers, each degree blocks deep
+#define STREAM_BUFFERS 4
+
+// what a stride table entry learned about one region
+typedef struct {
+    unsigned long int region;
+    unsigned long int last_block;
+    long int stride;
+    int confidence;
+    int valid;
+} StrideEntry;
+
+// FIFO of consecutive blocks being fetched, block head + k in slot (first + k) % MAX
+typedef struct {
+    unsigned long int head;
+    int first;
+    int count;
+    double ready[MAX_PREFETCH_DEGREE];  // simulation_clock the fill arrives
+    unsigned long int last_used;
+} StreamBuffer;
+
+// one level's prefetcher, plain data so checkpoints can copy it
+typedef struct {
+    int kind;
+    int degree;
+    StrideEntry strides[STRIDE_TABLE_SIZE];
+    StreamBuffer streams[STREAM_BUFFERS];
+    unsigned long int uses;             // stream buffer LRU clock
+} Prefetcher;
+
+// what one level's prefetcher did
+typedef struct {
+    unsigned long int issued;       // blocks fetched ahead of demand
+    unsigned long int useful;       // of those, used by a demand access
+    unsigned long int late;         // of the useful ones, used before their fill arrived
+    unsigned long int useless;      // evicted or dropped unused
+    unsigned long int misses;       // demand misses left
+    unsigned long int dram_reads;   // DRAM reads the prefetches caused
+} PrefetchStats;
+
+int prefetch_parse(const char* name);
+const char* prefetch_name(int kind);
+void prefetch_reset(Prefetcher* prefetcher, int kind, int degree);
+size_t prefetch_candidates(Prefetcher* prefetcher, unsigned long int block, int trigger, unsigned long int* blocks);
+int stream_take(Prefetcher* prefetcher, unsigned long int block, double* ready);
+StreamBuffer* stream_for(Prefetcher* prefetcher, unsigned long int head, unsigned long int* dropped);
+unsigned long int stream_next_block(const StreamBuffer* stream);
+void stream_append(StreamBuffer* stream, double ready);
+void add_prefetch_stats(PrefetchStats* total, const PrefetchStats* stats);
+double prefetch_dram_energy(const PrefetchStats* stats, const EnergyModel* model);
+
+#endif
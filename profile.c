@@ -0,0 +1,71 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "./profile.h"
+
+#if PROFILE
+
+Profile PROFILE_DATA;
+
+static const char* STAGE_NAMES[NUM_PROFILE_STAGES] = {
+    "Trace I/O", "Trace parse", "L1 icache", "L1 dcache", "L2", "L3", "DRAM", "Stats output"
+};
+
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/**
+ * Start timing the stages, from now until print_profile
+*/
+void profile_start(void) {
+    PROFILE_DATA.enabled = 1;
+    PROFILE_DATA.ticks = profile_ticks();
+    PROFILE_DATA.ns = now_ns();
+}
+
+
+/**
+ * References the run simulated, to average the stages over
+*/
+void profile_records(unsigned long int records) {
+    PROFILE_DATA.records = records;
+}
+
+
+/**
+ * Print each stage's time, per reference and as a share of the run.
+ * Ticks are turned into ns by the wall clock over the whole run, and
+ * whatever no stage claimed (batching, dispatch, the other output) is Other.
+*/
+void print_profile(void) {
+    Profile* p = &PROFILE_DATA;
+    uint64_t total = profile_ticks() - p->ticks;
+    double elapsed = now_ns() - p->ns;
+    double ns_per_tick = total ? elapsed / total : 0;
+    double records = p->records ? (double) p->records : 1;
+    p->enabled = 0;
+
+    printf("Profile (%lu references, %.2f ms):\n", p->records, elapsed / 1e6);
+    printf("Stage        | Calls        | Time (ms)  | ns/Reference | Share \n");
+    printf("-------------|--------------|------------|--------------|-------\n");
+    uint64_t claimed = 0;
+    for (int i = 0; i < NUM_PROFILE_STAGES; i++) {
+        double ns = p->self[i] * ns_per_tick;
+        claimed += p->self[i];
+        printf("%-12s | %-12lu | %-10.2f | %-12.2f | %5.1f%%\n", STAGE_NAMES[i], p->calls[i], ns / 1e6,
+            ns / records, total ? 100.0 * p->self[i] / total : 0);
+    }
+    uint64_t other = total > claimed ? total - claimed : 0;
+    printf("%-12s | %-12s | %-10.2f | %-12.2f | %5.1f%%\n", "Other", "", other * ns_per_tick / 1e6,
+        other * ns_per_tick / records, total ? 100.0 * other / total : 0);
+    printf("\nReferences/s: %.0f\n\n", elapsed > 0 ? p->records / (elapsed / 1e9) : 0);
+}
+
+#endif
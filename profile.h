@@ -0,0 +1,116 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// hot path timers, built in with make PROFILE=1 and started with --profile.
+// Without PROFILE every PROFILE_SCOPE is empty and nothing here is compiled.
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+// stages, each timed without the stages it calls
+#define PROFILE_TRACE_IO    0   // opening, mapping, seeking and closing traces
+#define PROFILE_TRACE_PARSE 1   // decoding records, page faults of mapped traces included
+#define PROFILE_L1I         2
+#define PROFILE_L1D         3
+#define PROFILE_L2          4
+#define PROFILE_L3          5
+#define PROFILE_DRAM        6
+#define PROFILE_STATS       7   // print_stats
+#define NUM_PROFILE_STAGES  8
+
+// deepest nesting of timed stages (an L1 down to DRAM, with prefetches)
+#define PROFILE_MAX_DEPTH 16
+
+#if PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct {
+    int enabled;
+    uint64_t self[NUM_PROFILE_STAGES];          // ticks in each stage, callees excluded
+    unsigned long int calls[NUM_PROFILE_STAGES];
+
+    // stages entered and not left yet
+    int depth;
+    int stage[PROFILE_MAX_DEPTH];
+    uint64_t start[PROFILE_MAX_DEPTH];
+
+    // the run, to turn ticks into ns
+    uint64_t ticks;
+    double ns;
+    unsigned long int records;
+} Profile;
+
+extern Profile PROFILE_DATA;
+
+
+/**
+ * Timestamp counter where there is one, else ns on the monotonic clock
+*/
+static inline uint64_t profile_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+/**
+ * Enter a stage. Returns the stage, -1 if it isn't timed.
+*/
+static inline int profile_enter(int stage) {
+    Profile* p = &PROFILE_DATA;
+    if (!p->enabled || p->depth == PROFILE_MAX_DEPTH) {
+        return -1;
+    }
+    p->stage[p->depth] = stage;
+    p->start[p->depth++] = profile_ticks();
+    return stage;
+}
+
+
+/**
+ * Leave the stage profile_enter returned, its time comes off the caller's
+*/
+static inline void profile_leave(const int* stage) {
+    if (*stage < 0) {
+        return;
+    }
+    Profile* p = &PROFILE_DATA;
+    uint64_t elapsed = profile_ticks() - p->start[--p->depth];
+    p->self[*stage] += elapsed;
+    p->calls[*stage]++;
+    if (p->depth > 0) {
+        p->self[p->stage[p->depth - 1]] -= elapsed;
+    }
+}
+
+// time the rest of the enclosing block as stage, every return included
+#define PROFILE_SCOPE(stage) \
+    int profile_scope_ __attribute__((cleanup(profile_leave))) = profile_enter(stage)
+
+// n more calls of stage, for accesses applied together in one call
+#define PROFILE_COUNT(stage, n) \
+    do { if (PROFILE_DATA.enabled) PROFILE_DATA.calls[stage] += (n); } while (0)
+
+void profile_start(void);
+void profile_records(unsigned long int records);
+void print_profile(void);
+
+#else
+
+#define PROFILE_SCOPE(stage)
+#define PROFILE_COUNT(stage, n)
+
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+
+#include "./replacement.h"
+
+
+static const char* const POLICY_NAMES[NUM_POLICIES] = {
+    "random", "lru", "plru", "srrip", "brrip", "xorshift"
+};
+
+
+/**
+ * Policy for a name, -1 if unknown
+*/
+int policy_parse(const char* name) {
+    for (int policy = 0; policy < NUM_POLICIES; policy++) {
+        if (strcmp(name, POLICY_NAMES[policy]) == 0) {
+            return policy;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Name of a policy
+*/
+const char* policy_name(int policy) {
+    return policy >= 0 && policy < NUM_POLICIES ? POLICY_NAMES[policy] : "unknown";
+}
+
+
+/**
+ * Whether a policy can run a set of this associativity, indexed if the
+ * level keeps a tag index (level_enable_index).
+ * Returns 0 if it can, -1 if not.
+*/
+int policy_check(int policy, unsigned long int associativity, int indexed) {
+    if (policy < 0 || policy >= NUM_POLICIES || associativity == 0) {
+        return -1;
+    }
+    if (policy == POLICY_LRU && associativity > LRU_MAX_WAYS && !indexed) {
+        return -1;
+    }
+    if (policy == POLICY_PLRU && (associativity & (associativity - 1)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Width of one state field, a power of two so fields never straddle a word.
+ * LRU ages get a spare top bit for the word at a time update.
+*/
+unsigned int policy_field_bits(int policy, unsigned long int associativity) {
+    switch (policy) {
+    case POLICY_LRU:
+        return associativity <= 2 ? 2 : associativity <= 8 ? 4 : 8;
+    case POLICY_PLRU:
+        return 1;
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+        return 2;
+    }
+    return 1;
+}
+
+
+/**
+ * State fields per set: one per way, one per tree node for PLRU, none for the random policies
+*/
+size_t policy_fields(int policy, unsigned long int associativity) {
+    switch (policy) {
+    case POLICY_LRU:
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+        return associativity;
+    case POLICY_PLRU:
+        return associativity - 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Cold replacement state: LRU ages (or list) ordered by way, PLRU pointing
+ * at way 0, every RRIP way at a distant re-reference. The random seed restarts.
+*/
+void policy_reset(CacheLevel* level) {
+    memset(level->policy_state, 0, level->num_sets * level->state_words * sizeof(uint64_t));
+    level->seed = 1;
+
+    if (level->lru_next) {
+        size_t ways = level->associativity;
+        for (size_t set = 0; set < level->num_sets; set++) {
+            uint32_t* prev = &level->lru_prev[set * ways];
+            uint32_t* next = &level->lru_next[set * ways];
+            for (size_t way = 0; way < ways; way++) {
+                prev[way] = way == 0 ? LRU_NONE : way - 1;
+                next[way] = way + 1 == ways ? LRU_NONE : way + 1;
+            }
+            level->lru_head[set] = 0;
+            level->lru_tail[set] = ways - 1;
+        }
+        return;
+    }
+
+    for (size_t set = 0; set < level->num_sets; set++) {
+        uint64_t* state = policy_set_state(level, set);
+        for (size_t way = 0; way < level->associativity; way++) {
+            if (level->policy == POLICY_LRU) {
+                policy_set_field(state, level->field_bits, way, way);
+            } else if (level->policy == POLICY_SRRIP || level->policy == POLICY_BRRIP) {
+                policy_set_field(state, 2, way, RRPV_MAX);
+            }
+        }
+    }
+}
@@ -0,0 +1,327 @@
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+#include <stdlib.h>
+
+#include "./cache_level.h"
+
+// replacement policies
+#define POLICY_RANDOM   0   // rand_r, the original L2 policy
+#define POLICY_LRU      1   // true LRU, one age per way
+#define POLICY_PLRU     2   // tree pseudo LRU, power of two associativity
+#define POLICY_SRRIP    3   // static re-reference interval prediction
+#define POLICY_BRRIP    4   // bimodal re-reference interval prediction
+#define POLICY_XORSHIFT 5   // xorshift32 random
+#define NUM_POLICIES    6
+
+// 2 bit re-reference prediction values
+#define RRPV_MAX 3
+
+// BRRIP inserts at RRPV_MAX - 1 on one miss in BRRIP_LONG_INTERVAL, else at RRPV_MAX
+#define BRRIP_LONG_INTERVAL 32
+
+// widest set LRU ages can order (8 bit ages with a clear top bit), indexed
+// levels keep an LRU list of any width instead
+#define LRU_MAX_WAYS 128
+
+// no way, ends an LRU list
+#define LRU_NONE UINT32_MAX
+
+int policy_parse(const char* name);
+const char* policy_name(int policy);
+int policy_check(int policy, unsigned long int associativity, int indexed);
+unsigned int policy_field_bits(int policy, unsigned long int associativity);
+size_t policy_fields(int policy, unsigned long int associativity);
+void policy_reset(CacheLevel* level);
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Packed per-set state
+ * Fields are 1, 2, 4 or 8 bits wide so none straddles a word.
+*/
+
+static inline uint64_t* policy_set_state(const CacheLevel* level, size_t set) {
+    return &level->policy_state[set * level->state_words];
+}
+
+static inline unsigned int policy_field(const uint64_t* state, unsigned int bits, size_t i) {
+    size_t bit = i * bits;
+    return state[bit >> 6] >> (bit & 63) & ((1u << bits) - 1);
+}
+
+static inline void policy_set_field(uint64_t* state, unsigned int bits, size_t i, unsigned int value) {
+    size_t bit = i * bits;
+    uint64_t mask = (uint64_t) ((1u << bits) - 1) << (bit & 63);
+    state[bit >> 6] = (state[bit >> 6] & ~mask) | ((uint64_t) value << (bit & 63) & mask);
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Random policies
+*/
+
+static inline size_t xorshift_next(CacheLevel* level) {
+    unsigned int x = level->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    level->seed = x;
+    return (size_t) (((uint64_t) x * level->associativity) >> 32);
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * LRU: field i is the age of way i, 0 = most recent.
+ * The ages of a set are always a permutation of 0..associativity-1.
+ * Fields keep their top bit clear, so a whole word of ages is compared and
+ * aged at once without borrows crossing fields.
+*/
+
+// value repeated in every bits wide field of a word
+static inline uint64_t lru_lanes(unsigned int bits, uint64_t value) {
+    return value * (~(uint64_t) 0 / (((uint64_t) 1 << bits) - 1));
+}
+
+// fields of word i of a set that hold a way
+static inline uint64_t lru_word_mask(const CacheLevel* level, size_t i) {
+    size_t per_word = 64 / level->field_bits;
+    size_t ways = level->associativity - i * per_word;
+    return ways >= per_word ? ~(uint64_t) 0 : ((uint64_t) 1 << (ways * level->field_bits)) - 1;
+}
+
+static inline void lru_touch(CacheLevel* level, size_t set, size_t way) {
+    uint64_t* state = policy_set_state(level, set);
+    unsigned int bits = level->field_bits;
+    unsigned int age = policy_field(state, bits, way);
+    if (age == 0) {
+        return;
+    }
+
+    // every way younger than the touched one ages by one
+    uint64_t high = lru_lanes(bits, (uint64_t) 1 << (bits - 1));
+    uint64_t below = lru_lanes(bits, age - 1) | high;
+    for (size_t i = 0; i < level->state_words; i++) {
+        uint64_t younger = (below - state[i]) & high & lru_word_mask(level, i);
+        state[i] += younger >> (bits - 1);
+    }
+    policy_set_field(state, bits, way, 0);
+}
+
+static inline size_t lru_victim(const CacheLevel* level, size_t set) {
+    const uint64_t* state = policy_set_state(level, set);
+    unsigned int bits = level->field_bits;
+    uint64_t ones = lru_lanes(bits, 1);
+    uint64_t high = ones << (bits - 1);
+    uint64_t oldest = lru_lanes(bits, level->associativity - 1);
+
+    // the one field equal to associativity - 1
+    for (size_t i = 0; i < level->state_words; i++) {
+        uint64_t diff = state[i] ^ oldest;
+        uint64_t zero = (diff - ones) & ~diff & high & lru_word_mask(level, i);
+        if (zero) {
+            return i * (64 / bits) + __builtin_ctzll(zero) / bits;
+        }
+    }
+    return 0;
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * LRU list of an indexed level: the set's ways from most to least recent.
+ * Touching moves a way to the head, the victim is the tail, so it orders
+ * the ways exactly like the ages.
+*/
+
+static inline void lru_list_touch(CacheLevel* level, size_t set, size_t way) {
+    uint32_t head = level->lru_head[set];
+    if (head == way) {
+        return;
+    }
+    size_t base = set * level->associativity;
+    uint32_t* prev = &level->lru_prev[base];
+    uint32_t* next = &level->lru_next[base];
+
+    // unlink, the way isn't the head so it has a prev
+    next[prev[way]] = next[way];
+    if (next[way] != LRU_NONE) {
+        prev[next[way]] = prev[way];
+    } else {
+        level->lru_tail[set] = prev[way];
+    }
+
+    prev[way] = LRU_NONE;
+    next[way] = head;
+    prev[head] = way;
+    level->lru_head[set] = way;
+}
+
+static inline size_t lru_list_victim(const CacheLevel* level, size_t set) {
+    return level->lru_tail[set];
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Tree PLRU: field i is node i of a heap ordered binary tree over the ways,
+ * 1 when the pseudo LRU way is in its right half.
+*/
+
+static inline void plru_touch(CacheLevel* level, size_t set, size_t way) {
+    uint64_t* state = policy_set_state(level, set);
+    size_t node = 0;
+    size_t low = 0;
+    for (size_t size = level->associativity; size > 1; size /= 2) {
+        size_t half = size / 2;
+        if (way < low + half) {
+            // touched the left half, point away from it
+            policy_set_field(state, 1, node, 1);
+            node = 2 * node + 1;
+        } else {
+            policy_set_field(state, 1, node, 0);
+            node = 2 * node + 2;
+            low += half;
+        }
+    }
+}
+
+static inline size_t plru_victim(const CacheLevel* level, size_t set) {
+    const uint64_t* state = policy_set_state(level, set);
+    size_t node = 0;
+    size_t low = 0;
+    for (size_t size = level->associativity; size > 1; size /= 2) {
+        size_t half = size / 2;
+        if (policy_field(state, 1, node)) {
+            node = 2 * node + 2;
+            low += half;
+        } else {
+            node = 2 * node + 1;
+        }
+    }
+    return low;
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * RRIP: field i is the re-reference prediction value of way i.
+ * Hits predict a near re-reference, misses evict a distant one.
+*/
+
+static inline void rrip_touch(CacheLevel* level, size_t set, size_t way) {
+    policy_set_field(policy_set_state(level, set), 2, way, 0);
+}
+
+static inline void rrip_insert(CacheLevel* level, size_t set, size_t way, unsigned int rrpv) {
+    policy_set_field(policy_set_state(level, set), 2, way, rrpv);
+}
+
+static inline size_t rrip_victim(CacheLevel* level, size_t set) {
+    uint64_t* state = policy_set_state(level, set);
+
+    // age every way at once until the oldest reaches RRPV_MAX
+    size_t victim = 0;
+    unsigned int oldest = 0;
+    for (size_t w = 0; w < level->associativity; w++) {
+        unsigned int rrpv = policy_field(state, 2, w);
+        if (rrpv > oldest) {
+            oldest = rrpv;
+            victim = w;
+            if (rrpv == RRPV_MAX) {
+                return victim;
+            }
+        }
+    }
+    for (size_t w = 0; w < level->associativity; w++) {
+        policy_set_field(state, 2, w, policy_field(state, 2, w) + RRPV_MAX - oldest);
+    }
+    return victim;
+}
+
+
+/** +++++++++++++++++++++++++++++++++++++++++++
+ * Dispatch
+ * Every policy is inlined into one switch on level->policy, so a reference
+ * costs a predictable branch and no indirect call.
+*/
+
+/**
+ * Record a hit on a way
+*/
+static inline void policy_touch(CacheLevel* level, size_t set, size_t way) {
+    switch (level->policy) {
+    case POLICY_LRU:
+        if (level->lru_next) {
+            lru_list_touch(level, set, way);
+        } else {
+            lru_touch(level, set, way);
+        }
+        break;
+    case POLICY_PLRU:
+        plru_touch(level, set, way);
+        break;
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+        rrip_touch(level, set, way);
+        break;
+    }
+}
+
+
+/**
+ * Record a fill of a way
+*/
+static inline void policy_insert(CacheLevel* level, size_t set, size_t way) {
+    switch (level->policy) {
+    case POLICY_LRU:
+        if (level->lru_next) {
+            lru_list_touch(level, set, way);
+        } else {
+            lru_touch(level, set, way);
+        }
+        break;
+    case POLICY_PLRU:
+        plru_touch(level, set, way);
+        break;
+    case POLICY_SRRIP:
+        rrip_insert(level, set, way, RRPV_MAX - 1);
+        break;
+    case POLICY_BRRIP:
+        if (rand_r(&level->seed) % BRRIP_LONG_INTERVAL == 0) {
+            rrip_insert(level, set, way, RRPV_MAX - 1);
+        } else {
+            rrip_insert(level, set, way, RRPV_MAX);
+        }
+        break;
+    }
+}
+
+
+/**
+ * Way to replace on a miss.
+ * Random keeps the original behaviour of ignoring invalid ways,
+ * every other policy fills an invalid way first.
+*/
+static inline size_t policy_victim(CacheLevel* level, size_t set) {
+    if (level->associativity == 1) {
+        return 0;
+    }
+    if (level->policy == POLICY_RANDOM) {
+        return rand_r(&level->seed) % level->associativity;
+    }
+
+    long invalid = level->index ? level_index_invalid(level, set) : level_find_invalid(level, set);
+    if (invalid >= 0) {
+        return invalid;
+    }
+
+    switch (level->policy) {
+    case POLICY_LRU:
+        return level->lru_next ? lru_list_victim(level, set) : lru_victim(level, set);
+    case POLICY_PLRU:
+        return plru_victim(level, set);
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+        return rrip_victim(level, set);
+    }
+    return xorshift_next(level);
+}
+
+#endif
@@ -0,0 +1,467 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+
+#include "./partition.h"
+#include "./sampling.h"
+
+
+// two sided 95% Student t quantiles for 1 to 30 degrees of freedom
+static const double T_95[30] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+// estimate and 95% confidence half width, interval < 0 if there's too little to tell
+typedef struct {
+    double value;
+    double interval;
+} Estimate;
+
+
+/**
+ * Parse --sample=period:window[:warmup] or --set-sample=partitions:sampled.
+ * Warm-up defaults to everything outside the window (SMARTS functional warming).
+ * Returns 0 on success, -1 on garbage.
+*/
+int parse_sample(const char* spec, int method, SampleConfig* sample) {
+    unsigned long int fields[3] = { 0, 0, 0 };
+    int count = 0;
+    const char* p = spec;
+    while (count < 3) {
+        char* end;
+        fields[count++] = strtoul(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        if (*end == '\0') {
+            break;
+        }
+        if (*end != ':') {
+            return -1;
+        }
+        p = end + 1;
+    }
+
+    memset(sample, 0, sizeof(*sample));
+    sample->method = method;
+    if (method == SAMPLE_WINDOWS && (count == 2 || count == 3)) {
+        sample->period = fields[0];
+        sample->window = fields[1];
+        if (count == 3) {
+            sample->warmup = fields[2];
+        } else if (fields[1] <= fields[0]) {
+            sample->warmup = fields[0] - fields[1];
+        }
+        return 0;
+    }
+    if (method == SAMPLE_SETS && count == 2) {
+        sample->partitions = fields[0];
+        sample->sampled = fields[1];
+        return 0;
+    }
+    return -1;
+}
+
+
+/**
+ * Check a sampling plan fits the configurations.
+ * Returns 0 if so, -1 with the reason in error if not.
+*/
+int check_sample(const SampleConfig* sample, const CacheConfig* configs, size_t num_configs,
+                 char* error, size_t error_size) {
+    for (size_t i = 0; i < num_configs; i++) {
+        if (configs[i].issue_window) {
+            snprintf(error, error_size, "the non-blocking timing model (issue-window) needs every record");
+            return -1;
+        }
+        if (configs[i].classify) {
+            snprintf(error, error_size, "miss classification (--classify-misses) needs every access");
+            return -1;
+        }
+        // prefetch fills are due at absolute clock times, which windows restart
+        if (configs[i].l1d.prefetch != PREFETCH_NONE || configs[i].l2.prefetch != PREFETCH_NONE) {
+            snprintf(error, error_size, "prefetchers time their fills on the clock sampling resets");
+            return -1;
+        }
+    }
+
+    if (sample->method == SAMPLE_WINDOWS) {
+        if (sample->window == 0 || sample->window > sample->period) {
+            snprintf(error, error_size, "a %lu record window doesn't fit a %lu record period",
+                sample->window, sample->period);
+            return -1;
+        }
+        if (sample->warmup > sample->period - sample->window) {
+            snprintf(error, error_size, "a %lu record window and %lu record warm-up don't fit a %lu record period",
+                sample->window, sample->warmup, sample->period);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (sample->sampled < 2 || sample->sampled > sample->partitions) {
+        snprintf(error, error_size, "%d of %d set partitions, need at least 2 of them", sample->sampled, sample->partitions);
+        return -1;
+    }
+    return check_partitions(configs, num_configs, sample->partitions, error, error_size);
+}
+
+
+/**
+ * Keep one measured unit
+*/
+static void add_unit(Samples* samples, unsigned long int records, const CacheStats* stats) {
+    if (samples->num_units == samples->capacity) {
+        samples->capacity = samples->capacity ? 2 * samples->capacity : 64;
+        samples->units = realloc(samples->units, samples->capacity * sizeof(SampleUnit));
+        if (!samples->units) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+    }
+    samples->units[samples->num_units].records = records;
+    samples->units[samples->num_units].stats = *stats;
+    samples->num_units++;
+}
+
+
+/**
+ * Decode count records and run them through every simulator, or only
+ * check them if simulate is 0. Returns TRACE_RECORD if all count were
+ * there, else how the trace ended; an invalid record ends it in result.
+*/
+static int feed(TraceReader* reader, TraceRecord* batch, CacheSim** sims, size_t num_sims,
+                unsigned long int count, int simulate, RunResult* result) {
+    int status = TRACE_RECORD;
+    while (count > 0 && status == TRACE_RECORD) {
+        size_t wanted = count < SWEEP_BATCH_SIZE ? count : SWEEP_BATCH_SIZE;
+        size_t got = 0;
+        while (got < wanted && (status = trace_next(reader, &batch[got])) == TRACE_RECORD) {
+            got++;
+        }
+
+        for (size_t j = 0; j < got; j++) {
+            if (!record_valid(&batch[j])) {
+                result->status = RUN_INVALID_OP;
+                result->record = batch[j];
+                return TRACE_EOF;
+            }
+        }
+        for (size_t i = 0; simulate && i < num_sims; i++) {
+            for (size_t j = 0; j < got; j++) {
+                simulate_record(sims[i], &batch[j]);
+            }
+        }
+
+        result->records += got;
+        count -= got;
+    }
+    return status;
+}
+
+
+/**
+ * SMARTS style sampling: per period skip, warm up, then measure a window.
+ * Warm-up only keeps tags and replacement state (no payloads) and its
+ * stats are thrown away, so each simulator ends up with the windows' stats.
+*/
+static int run_windows(TraceReader* reader, CacheSim** sims, size_t num_sims,
+                       const SampleConfig* sample, Samples* samples, RunResult* result) {
+    TraceRecord* batch = malloc(SWEEP_BATCH_SIZE * sizeof(TraceRecord));
+    if (!batch) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    CacheStats saved[MAX_SWEEP_CONFIGS];
+    int tags_only[MAX_SWEEP_CONFIGS];
+    unsigned long int skip = sample->period - sample->window - sample->warmup;
+    int status = TRACE_RECORD;
+
+    while (status == TRACE_RECORD && result->status == RUN_OK) {
+        status = feed(reader, batch, sims, num_sims, skip, 0, result);
+        if (status != TRACE_RECORD) {
+            break;
+        }
+
+        // functional warming
+        for (size_t i = 0; i < num_sims; i++) {
+            saved[i] = sims[i]->stats;
+            tags_only[i] = sims[i]->config.tags_only;
+            sims[i]->config.tags_only = 1;
+        }
+        status = feed(reader, batch, sims, num_sims, sample->warmup, 1, result);
+        for (size_t i = 0; i < num_sims; i++) {
+            sims[i]->stats = saved[i];
+            sims[i]->config.tags_only = tags_only[i];
+        }
+        if (status != TRACE_RECORD) {
+            break;
+        }
+
+        // detailed window, counted on its own
+        unsigned long int start = result->records;
+        for (size_t i = 0; i < num_sims; i++) {
+            saved[i] = sims[i]->stats;
+            memset(&sims[i]->stats, 0, sizeof(CacheStats));
+        }
+        status = feed(reader, batch, sims, num_sims, sample->window, 1, result);
+        unsigned long int measured = result->records - start;
+        for (size_t i = 0; i < num_sims; i++) {
+            if (measured > 0) {
+                add_unit(&samples[i], measured, &sims[i]->stats);
+            }
+            add_stats(&saved[i], &sims[i]->stats);
+            sims[i]->stats = saved[i];
+        }
+    }
+
+    free(batch);
+    return status;
+}
+
+
+/**
+ * Set sampling: split every level into partitions by set like
+ * --partitions does and only simulate a few of the partitions, picked at
+ * random. Evenly spaced ones would all share their low set index bits,
+ * which lines up with how data is aligned. Records of the other partitions
+ * are only decoded.
+*/
+static int run_sets(TraceReader* reader, CacheSim** sims, size_t num_sims,
+                    const SampleConfig* sample, Samples* samples, RunResult* result) {
+    // partition bits above the largest block of any configuration
+    CacheConfig configs[MAX_SWEEP_CONFIGS];
+    unsigned int shift = 0;
+    for (size_t i = 0; i < num_sims; i++) {
+        unsigned int block_shift = partition_shift(&sims[i]->config, 1);
+        if (block_shift > shift) {
+            shift = block_shift;
+        }
+        configs[i] = sims[i]->config;
+        partition_config(&configs[i], sample->partitions);
+    }
+    unsigned int bits = __builtin_ctz(sample->partitions);
+
+    // slot of each partition among the sampled ones, -1 if not sampled
+    int slot[MAX_PARTITIONS];
+    for (int p = 0; p < sample->partitions; p++) {
+        slot[p] = -1;
+    }
+    CacheSim* slices[MAX_PARTITIONS][MAX_SWEEP_CONFIGS];
+    unsigned long int records[MAX_PARTITIONS] = { 0 };
+    unsigned int seed = SAMPLE_SEED;
+    for (int g = 0; g < sample->sampled; g++) {
+        int p;
+        do {
+            p = rand_r(&seed) % sample->partitions;
+        } while (slot[p] >= 0);
+        slot[p] = g;
+        for (size_t i = 0; i < num_sims; i++) {
+            slices[g][i] = create_simulator(&configs[i]);
+        }
+    }
+
+    TraceRecord record;
+    int status;
+    while ((status = trace_next(reader, &record)) == TRACE_RECORD) {
+        if (!record_valid(&record)) {
+            result->status = RUN_INVALID_OP;
+            result->record = record;
+            break;
+        }
+        result->records++;
+
+        int g = slot[(record.address >> shift) & (sample->partitions - 1)];
+        if (g < 0) {
+            continue;
+        }
+        record.address = partition_address(record.address, shift, bits);
+        for (size_t i = 0; i < num_sims; i++) {
+            simulate_record(slices[g][i], &record);
+        }
+        records[g]++;
+    }
+
+    for (int g = 0; g < sample->sampled; g++) {
+        for (size_t i = 0; i < num_sims; i++) {
+            add_unit(&samples[i], records[g], &slices[g][i]->stats);
+            add_stats(&sims[i]->stats, &slices[g][i]->stats);
+            destroy_simulator(slices[g][i]);
+        }
+    }
+    return status;
+}
+
+
+/**
+ * Run a sample of a trace through every simulator.
+ * samples gets each configuration's measured units, and each simulator's
+ * stats are the sum of them.
+*/
+RunResult run_sampled_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                            const SampleConfig* sample, Samples* samples) {
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+    memset(samples, 0, num_sims * sizeof(Samples));
+
+    TraceReader reader;
+    if (trace_open(&reader, filename, reader_kind) != 0) {
+        result.status = RUN_OPEN_FAILED;
+        return result;
+    }
+
+    int status = sample->method == SAMPLE_WINDOWS
+        ? run_windows(&reader, sims, num_sims, sample, samples, &result)
+        : run_sets(&reader, sims, num_sims, sample, samples, &result);
+
+    if (result.status == RUN_OK && status == TRACE_MALFORMED) {
+        result.status = RUN_MALFORMED;
+        result.line = reader.line;
+    }
+
+    for (size_t i = 0; i < num_sims; i++) {
+        samples[i].trace_records = result.records;
+        if (sample->method == SAMPLE_SETS) {
+            samples[i].fraction = (double) sample->sampled / sample->partitions;
+        } else {
+            unsigned long int measured = 0;
+            for (size_t u = 0; u < samples[i].num_units; u++) {
+                measured += samples[i].units[u].records;
+            }
+            samples[i].fraction = result.records ? (double) measured / result.records : 0.0;
+        }
+    }
+
+    trace_close(&reader);
+    return result;
+}
+
+
+/**
+ * Ratio estimate sum(y) / sum(x) over the units, with the confidence
+ * interval from its linearised variance, corrected for the measured
+ * fraction of a finite population
+*/
+static Estimate ratio_estimate(const double* y, const double* x, size_t n, double fraction) {
+    Estimate estimate = { 0.0, -1.0 };
+    double sum_y = 0.0;
+    double sum_x = 0.0;
+    for (size_t u = 0; u < n; u++) {
+        sum_y += y[u];
+        sum_x += x[u];
+    }
+    if (sum_x == 0.0) {
+        return estimate;
+    }
+    estimate.value = sum_y / sum_x;
+    if (n < 2) {
+        return estimate;
+    }
+
+    double squares = 0.0;
+    for (size_t u = 0; u < n; u++) {
+        double residual = y[u] - estimate.value * x[u];
+        squares += residual * residual;
+    }
+    double mean_x = sum_x / n;
+    double variance = (1.0 - fraction) * squares / (n - 1) / n / (mean_x * mean_x);
+    double t = n - 1 <= 30 ? T_95[n - 2] : 1.96;
+    estimate.interval = t * sqrt(variance);
+    return estimate;
+}
+
+
+/**
+ * One line of the estimates table, scaled by scale
+*/
+static void print_estimate(const char* name, Estimate estimate, double scale, const char* format) {
+    char value[32];
+    char interval[32];
+    snprintf(value, sizeof(value), format, estimate.value * scale);
+    if (estimate.interval < 0) {
+        snprintf(interval, sizeof(interval), "n/a");
+    } else {
+        snprintf(interval, sizeof(interval), format, estimate.interval * scale);
+    }
+    printf("%-24s | %-20s | %s\n", name, value, interval);
+}
+
+
+/**
+ * Print the whole trace estimates of one configuration with 95% confidence intervals.
+ * Hit rates are ratio estimates over the units; access time and energy are
+ * per record ratio estimates scaled up to every record of the trace.
+*/
+void print_sample_estimates(const Samples* samples, const SampleConfig* sample, int has_l3, const EnergyModel* model) {
+    size_t n = samples->num_units;
+    double* y = malloc((n + 1) * sizeof(double));
+    double* x = malloc((n + 1) * sizeof(double));
+    if (!y || !x) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+
+    unsigned long int measured = 0;
+    for (size_t u = 0; u < n; u++) {
+        measured += samples->units[u].records;
+    }
+
+    printf("Sampled Estimates (95%% confidence):\n");
+    if (sample->method == SAMPLE_WINDOWS) {
+        printf("%zu windows of %lu records every %lu, %lu records of warm-up each\n",
+            n, sample->window, sample->period, sample->warmup);
+    } else {
+        printf("%d of %d set partitions\n", sample->sampled, sample->partitions);
+    }
+    printf("Measured %lu of %lu records (%.2f%%)\n", measured, samples->trace_records,
+        samples->trace_records ? 100.0 * measured / samples->trace_records : 0.0);
+    printf("Estimate                 | Value                | +/-\n");
+    printf("-------------------------|----------------------|---------------------\n");
+
+    // hit rates per level
+    const char* names[4] = { "L1 icache hit rate", "L1 dcache hit rate", "L2 hit rate", "L3 hit rate" };
+    for (int level = 0; level < (has_l3 ? 4 : 3); level++) {
+        for (size_t u = 0; u < n; u++) {
+            const CacheStats* stats = &samples->units[u].stats;
+            unsigned long int hits[4] = { stats->l1_icache_hits, stats->l1_dcache_hits, stats->l2_hits, stats->l3_hits };
+            unsigned long int misses[4] = { stats->l1_icache_misses, stats->l1_dcache_misses, stats->l2_misses, stats->l3_misses };
+            y[u] = hits[level];
+            x[u] = hits[level] + misses[level];
+        }
+        print_estimate(names[level], ratio_estimate(y, x, n, samples->fraction), 1.0, "%.6f");
+    }
+
+    // per record totals scaled to the trace
+    double scale = samples->trace_records;
+    for (size_t u = 0; u < n; u++) {
+        y[u] = samples->units[u].stats.simulation_clock;
+        x[u] = samples->units[u].records;
+    }
+    print_estimate("Total Access Time", ratio_estimate(y, x, n, samples->fraction), scale, "%.2f");
+
+    for (int kind = 0; kind < 2; kind++) {
+        for (size_t u = 0; u < n; u++) {
+            EnergyTotals energy;
+            compute_energy(&samples->units[u].stats.energy, has_l3, model, &energy);
+            y[u] = kind == 0 ? energy.total_dynamic : energy.total_static;
+        }
+        print_estimate(kind == 0 ? "Total Dynamic Energy (W)" : "Total Static Energy (pJ)",
+            ratio_estimate(y, x, n, samples->fraction), scale, "%.2f");
+    }
+    printf("\n");
+
+    free(y);
+    free(x);
+}
+
+
+/**
+ * Free the units of one configuration
+*/
+void free_samples(Samples* samples) {
+    free(samples->units);
+    memset(samples, 0, sizeof(*samples));
+}
@@ -0,0 +1,52 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "./cache_simulator.h"
+
+// sampling methods
+#define SAMPLE_NONE    0
+#define SAMPLE_WINDOWS 1    // SMARTS style periodic windows
+#define SAMPLE_SETS    2    // a few set partitions out of many
+
+// picks the set partitions, fixed so runs repeat
+#define SAMPLE_SEED 1
+
+// how to sample a trace
+typedef struct {
+    int method;
+
+    // SAMPLE_WINDOWS: out of every period records, skip the first ones,
+    // warm up the caches on warmup records, then measure window records
+    unsigned long int period;
+    unsigned long int window;
+    unsigned long int warmup;
+
+    // SAMPLE_SETS: simulate sampled of partitions set partitions (partition.h)
+    int partitions;
+    int sampled;
+} SampleConfig;
+
+// one measured window or set partition
+typedef struct {
+    unsigned long int records;
+    CacheStats stats;
+} SampleUnit;
+
+// the measured units of one configuration
+typedef struct {
+    SampleUnit* units;
+    size_t num_units;
+    size_t capacity;
+    unsigned long int trace_records;    // records in the whole trace
+    double fraction;                    // share of the population measured
+} Samples;
+
+int parse_sample(const char* spec, int method, SampleConfig* sample);
+int check_sample(const SampleConfig* sample, const CacheConfig* configs, size_t num_configs,
+                 char* error, size_t error_size);
+RunResult run_sampled_trace(const char* filename, int reader_kind, CacheSim** sims, size_t num_sims,
+                            const SampleConfig* sample, Samples* samples);
+void print_sample_estimates(const Samples* samples, const SampleConfig* sample, int has_l3, const EnergyModel* model);
+void free_samples(Samples* samples);
+
+#endif
@@ -0,0 +1,378 @@
+#include "./stack_distance.h"
+
+
+#define EMPTY_BLOCK (~0UL)
+
+
+/**
+ * Slot for a block number in a table of size (power of two)
+*/
+static size_t hash_block(unsigned long int block, size_t table_size) {
+    return (block * 0x9E3779B97F4A7C15UL) >> 17 & (table_size - 1);
+}
+
+
+/**
+ * Allocate or die
+*/
+static void* checked_calloc(size_t count, size_t size) {
+    void* p = calloc(count, size);
+    if (!p) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+
+/**
+ * Fenwick tree: add delta at timestamp i (1 based)
+*/
+static void tree_add(unsigned int* tree, size_t size, size_t i, int delta) {
+    for (; i <= size; i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+
+/**
+ * Fenwick tree: number of marked timestamps in 1..i
+*/
+static unsigned long int tree_prefix(const unsigned int* tree, size_t i) {
+    unsigned long int sum = 0;
+    for (; i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+
+/**
+ * Create an empty analysis
+*/
+StackDistance* create_stack_distance(unsigned long int block_size) {
+    StackDistance* sd = checked_calloc(1, sizeof(StackDistance));
+    sd->block_size = block_size;
+    sd->block_shift = __builtin_ctzl(block_size);
+
+    sd->table_size = 1 << 16;
+    sd->keys = malloc(sd->table_size * sizeof(unsigned long int));
+    sd->stamps = malloc(sd->table_size * sizeof(unsigned long int));
+    if (!sd->keys || !sd->stamps) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    memset(sd->keys, 0xff, sd->table_size * sizeof(unsigned long int));
+
+    sd->tree_size = MRC_INITIAL_STAMPS;
+    sd->tree = checked_calloc(sd->tree_size + 1, sizeof(unsigned int));
+
+    for (int k = 0; k < MRC_NUM_SET_COUNTS; k++) {
+        size_t sets = (size_t) 1 << (MRC_MIN_SET_LOG + k);
+        sd->set_stacks[k] = checked_calloc(sets * MRC_MAX_WAYS, sizeof(unsigned long int));
+        sd->set_fill[k] = checked_calloc(sets, sizeof(unsigned char));
+    }
+
+    return sd;
+}
+
+
+/**
+ * Free an analysis
+*/
+void destroy_stack_distance(StackDistance* sd) {
+    for (int k = 0; k < MRC_NUM_SET_COUNTS; k++) {
+        free(sd->set_stacks[k]);
+        free(sd->set_fill[k]);
+    }
+    free(sd->keys);
+    free(sd->stamps);
+    free(sd->tree);
+    free(sd);
+}
+
+
+/**
+ * Double the block table
+*/
+static void grow_table(StackDistance* sd) {
+    size_t old_size = sd->table_size;
+    unsigned long int* old_keys = sd->keys;
+    unsigned long int* old_stamps = sd->stamps;
+
+    sd->table_size *= 2;
+    sd->keys = malloc(sd->table_size * sizeof(unsigned long int));
+    sd->stamps = malloc(sd->table_size * sizeof(unsigned long int));
+    if (!sd->keys || !sd->stamps) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    memset(sd->keys, 0xff, sd->table_size * sizeof(unsigned long int));
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (old_keys[i] == EMPTY_BLOCK) {
+            continue;
+        }
+        size_t slot = hash_block(old_keys[i], sd->table_size);
+        while (sd->keys[slot] != EMPTY_BLOCK) {
+            slot = (slot + 1) & (sd->table_size - 1);
+        }
+        sd->keys[slot] = old_keys[i];
+        sd->stamps[slot] = old_stamps[i];
+    }
+
+    free(old_keys);
+    free(old_stamps);
+}
+
+
+/**
+ * Out of timestamps: renumber the live ones 1..num_blocks in order.
+ * The tree grows so at least half of it is free again afterwards.
+*/
+static void compact_stamps(StackDistance* sd) {
+    // slot of the block last touched at each timestamp
+    size_t* slot_at = malloc((sd->now + 1) * sizeof(size_t));
+    if (!slot_at) {
+        fprintf(stderr, "Malloc failed\n");
+        exit(1);
+    }
+    memset(slot_at, 0xff, (sd->now + 1) * sizeof(size_t));
+    for (size_t i = 0; i < sd->table_size; i++) {
+        if (sd->keys[i] != EMPTY_BLOCK) {
+            slot_at[sd->stamps[i]] = i;
+        }
+    }
+
+    unsigned long int next = 0;
+    for (unsigned long int t = 1; t <= sd->now; t++) {
+        if (slot_at[t] != (size_t) -1) {
+            sd->stamps[slot_at[t]] = ++next;
+        }
+    }
+    free(slot_at);
+
+    while (sd->num_blocks * 2 > sd->tree_size) {
+        sd->tree_size *= 2;
+    }
+    free(sd->tree);
+    sd->tree = checked_calloc(sd->tree_size + 1, sizeof(unsigned int));
+
+    // linear build, every stamp 1..next is marked
+    for (size_t i = 1; i <= sd->tree_size; i++) {
+        sd->tree[i] += i <= next;
+        size_t parent = i + (i & -i);
+        if (parent <= sd->tree_size) {
+            sd->tree[parent] += sd->tree[i];
+        }
+    }
+    sd->now = next;
+}
+
+
+/**
+ * Move a block to the front of its set's LRU stack for every set count
+*/
+static void set_stacks_access(StackDistance* sd, unsigned long int block) {
+    for (int k = 0; k < MRC_NUM_SET_COUNTS; k++) {
+        size_t set = block & (((size_t) 1 << (MRC_MIN_SET_LOG + k)) - 1);
+        unsigned long int* stack = &sd->set_stacks[k][set * MRC_MAX_WAYS];
+        unsigned char* fill = &sd->set_fill[k][set];
+
+        int depth = 0;
+        while (depth < *fill && stack[depth] != block) {
+            depth++;
+        }
+
+        if (depth < *fill) {
+            sd->set_hist[k][depth]++;
+        } else {
+            sd->set_hist[k][MRC_MAX_WAYS]++;
+            if (*fill < MRC_MAX_WAYS) {
+                (*fill)++;
+            }
+            depth = *fill - 1;
+        }
+
+        memmove(stack + 1, stack, depth * sizeof(unsigned long int));
+        stack[0] = block;
+    }
+}
+
+
+/**
+ * Record one reference
+*/
+void stack_distance_access(StackDistance* sd, unsigned long int address) {
+    unsigned long int block = address >> sd->block_shift;
+    sd->references++;
+
+    set_stacks_access(sd, block);
+
+    if (sd->now == sd->tree_size) {
+        compact_stamps(sd);
+    }
+
+    size_t slot = hash_block(block, sd->table_size);
+    while (sd->keys[slot] != EMPTY_BLOCK && sd->keys[slot] != block) {
+        slot = (slot + 1) & (sd->table_size - 1);
+    }
+
+    if (sd->keys[slot] == block) {
+        // distinct blocks touched since the last access to this one
+        unsigned long int last = sd->stamps[slot];
+        unsigned long int distance = sd->num_blocks - tree_prefix(sd->tree, last);
+        int bucket = distance ? 64 - __builtin_clzl(distance) : 0;
+        sd->distance_hist[bucket < MRC_MAX_LOG ? bucket : MRC_MAX_LOG]++;
+        tree_add(sd->tree, sd->tree_size, last, -1);
+    } else {
+        sd->keys[slot] = block;
+        sd->num_blocks++;
+        sd->cold_misses++;
+    }
+
+    sd->stamps[slot] = ++sd->now;
+    tree_add(sd->tree, sd->tree_size, sd->now, 1);
+
+    if (sd->num_blocks * 2 > sd->table_size) {
+        grow_table(sd);
+    }
+}
+
+
+/**
+ * Print misses for every power of two capacity, then the set associative grid
+*/
+void print_miss_ratio_curve(const StackDistance* sd) {
+    double references = sd->references ? sd->references : 1;
+
+    printf("\nMiss Ratio Curve (fully associative LRU, %lu byte blocks):\n", sd->block_size);
+    printf("References: %lu, Distinct blocks: %lu\n\n", sd->references, sd->num_blocks);
+    printf("Capacity (B)  | # Misses    | Miss Ratio \n");
+    printf("--------------|-------------|-----------\n");
+
+    unsigned long int hits = 0;
+    for (int log = 0; log <= MRC_MAX_LOG; log++) {
+        hits += sd->distance_hist[log];
+        unsigned long int misses = sd->references - hits;
+        printf("%-12lu  | %-9lu   | %.6f\n", sd->block_size << log, misses, misses / references);
+        if (((unsigned long int) 1 << log) >= sd->num_blocks) {
+            break;
+        }
+    }
+    printf("\n");
+
+    printf("Set Associative LRU Misses (capacity = sets x ways x %lu B):\n", sd->block_size);
+    printf("Sets      |");
+    for (int ways = 1; ways <= MRC_MAX_WAYS; ways *= 2) {
+        char label[16];
+        snprintf(label, sizeof(label), "%d-way", ways);
+        printf(" %-11s |", label);
+    }
+    printf("\n----------|");
+    for (int ways = 1; ways <= MRC_MAX_WAYS; ways *= 2) {
+        printf("-------------|");
+    }
+    printf("\n");
+
+    for (int k = 0; k < MRC_NUM_SET_COUNTS; k++) {
+        printf("%-9lu |", (unsigned long int) 1 << (MRC_MIN_SET_LOG + k));
+        unsigned long int set_hits = 0;
+        int depth = 0;
+        for (int ways = 1; ways <= MRC_MAX_WAYS; ways *= 2) {
+            for (; depth < ways; depth++) {
+                set_hits += sd->set_hist[k][depth];
+            }
+            printf(" %-11lu |", sd->references - set_hits);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+
+/**
+ * cache_simulator mrc <trace_file.din> <--reader=...> <--stream=unified|instruction|data>
+*/
+int mrc_main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s mrc <trace_file.din> <--reader=stdio|mmap> <--stream=unified|instruction|data> <--config=file> <--block-size=B>\n", argv[0]);
+        return 1;
+    }
+
+    int reader_kind = READER_MMAP;
+    int stream = MRC_STREAM_UNIFIED;
+    CacheConfig config;
+    default_config(&config);
+    for (int i = 3; i < argc; i++) {
+        if (strncmp(argv[i], "--reader=", 9) == 0) {
+            reader_kind = trace_parse_reader(argv[i] + 9);
+            if (reader_kind < 0) {
+                fprintf(stderr, "Invalid reader, expected stdio or mmap\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stream=unified") == 0) {
+            stream = MRC_STREAM_UNIFIED;
+        } else if (strcmp(argv[i], "--stream=instruction") == 0) {
+            stream = MRC_STREAM_INSTRUCTION;
+        } else if (strcmp(argv[i], "--stream=data") == 0) {
+            stream = MRC_STREAM_DATA;
+        } else if (strncmp(argv[i], "--config=", 9) == 0) {
+            if (load_config_file(argv[i] + 9, &config) != 0) {
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0 && strchr(argv[i], '=')) {
+            // config keys, of which the curves use the block size
+            const char* value = strchr(argv[i], '=') + 1;
+            char key[CONFIG_MAX_LINE];
+            snprintf(key, sizeof(key), "%.*s", (int) (value - argv[i] - 3), argv[i] + 2);
+            if (set_config_key(&config, key, value) != 0) {
+                fprintf(stderr, "Invalid option %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    char error[CONFIG_MAX_LINE];
+    if (check_config(&config, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Invalid configuration: %s\n", error);
+        return 1;
+    }
+
+    TraceReader reader;
+    if (trace_open(&reader, argv[2], reader_kind) != 0) {
+        fprintf(stderr, "Error: Unable to open trace file. Is it in Dinero 3 .din format?\n");
+        exit(1);
+    }
+
+    printf("File: %s\n\n", argv[2]);
+    printf("Running analysis ...\n");
+
+    StackDistance* sd = create_stack_distance(config.block_size);
+    TraceRecord record;
+    int status;
+    while ((status = trace_next(&reader, &record)) == TRACE_RECORD) {
+        int opcode = record.operation - '0';
+        int wanted = stream == MRC_STREAM_UNIFIED
+            || (stream == MRC_STREAM_INSTRUCTION && opcode == INSTR_FETCH)
+            || (stream == MRC_STREAM_DATA && (opcode == MEMORY_READ || opcode == MEMORY_WRITE));
+        if (wanted && opcode >= MEMORY_READ && opcode <= INSTR_FETCH) {
+            stack_distance_access(sd, record.address);
+        }
+    }
+
+    if (status == TRACE_MALFORMED) {
+        fprintf(stderr, "Error: Malformed trace record on line %lu.\n", reader.line);
+        exit(1);
+    }
+    trace_close(&reader);
+
+    printf("Analysis Complete.\n");
+    print_miss_ratio_curve(sd);
+    destroy_stack_distance(sd);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include "./cache_simulator.h"
+
+// distance histogram buckets, bucket k holds distances with bit length k
+#define MRC_MAX_LOG 48
+
+// set associative curves: set counts 2^MRC_MIN_SET_LOG .. 2^MRC_MAX_SET_LOG
+// with per-set LRU stacks of MRC_MAX_WAYS blocks
+#define MRC_MIN_SET_LOG 6
+#define MRC_MAX_SET_LOG 14
+#define MRC_NUM_SET_COUNTS (MRC_MAX_SET_LOG - MRC_MIN_SET_LOG + 1)
+#define MRC_MAX_WAYS 16
+
+// first Fenwick tree size, doubles as the number of live blocks grows
+#define MRC_INITIAL_STAMPS (1 << 20)
+
+// which references feed the curve
+#define MRC_STREAM_UNIFIED     0
+#define MRC_STREAM_INSTRUCTION 1
+#define MRC_STREAM_DATA        2
+
+// one pass LRU stack distance analysis
+typedef struct {
+    unsigned long int block_size;
+    unsigned int block_shift;
+
+    // block -> time of its last access (open addressing)
+    unsigned long int* keys;
+    unsigned long int* stamps;
+    size_t table_size;
+    size_t num_blocks;
+
+    // Fenwick tree over timestamps, 1 where a block was last touched
+    unsigned int* tree;
+    size_t tree_size;
+    unsigned long int now;
+
+    // fully associative results
+    unsigned long int references;
+    unsigned long int cold_misses;
+    unsigned long int distance_hist[MRC_MAX_LOG + 1];
+
+    // set associative results, per-set stacks of block numbers (most recent first)
+    unsigned long int* set_stacks[MRC_NUM_SET_COUNTS];
+    unsigned char* set_fill[MRC_NUM_SET_COUNTS];
+    unsigned long int set_hist[MRC_NUM_SET_COUNTS][MRC_MAX_WAYS + 1];
+} StackDistance;
+
+StackDistance* create_stack_distance(unsigned long int block_size);
+void destroy_stack_distance(StackDistance* sd);
+void stack_distance_access(StackDistance* sd, unsigned long int address);
+void print_miss_ratio_curve(const StackDistance* sd);
+int mrc_main(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+
+#include "./synthetic.h"
+
+
+static const char* SYNTHETIC_NAMES[NUM_SYNTHETIC] = {
+    "sequential", "stride", "random", "zipf", "pointer-chase", "mixed"
+};
+
+
+/**
+ * Map a generator name to its SYNTH_* kind, -1 if unknown
+*/
+int synthetic_parse(const char* name) {
+    for (int kind = 0; kind < NUM_SYNTHETIC; kind++) {
+        if (strcmp(name, SYNTHETIC_NAMES[kind]) == 0) {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Name of a generator
+*/
+const char* synthetic_name(int kind) {
+    return kind >= 0 && kind < NUM_SYNTHETIC ? SYNTHETIC_NAMES[kind] : "unknown";
+}
+
+
+/**
+ * xorshift64*, the generators need more than rand_r's 31 bits
+*/
+static unsigned long int next_random(SyntheticTrace* gen) {
+    unsigned long int x = gen->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    gen->state = x;
+    return x * 0x2545F4914F6CDD1DUL;
+}
+
+
+/**
+ * Uniform value below bound
+*/
+static unsigned long int random_below(SyntheticTrace* gen, unsigned long int bound) {
+    return next_random(gen) % bound;
+}
+
+
+/**
+ * Zipf distributed block: draw a rank from the CDF, then scatter the ranks
+ * over the footprint so the hot blocks don't share a few sets.
+ * Scattering is a permutation when the block count is a power of two.
+*/
+static unsigned long int zipf_block(SyntheticTrace* gen) {
+    double u = (next_random(gen) >> 11) * (1.0 / 9007199254740992.0);
+    unsigned long int low = 0;
+    unsigned long int high = gen->blocks - 1;
+    while (low < high) {
+        unsigned long int mid = low + (high - low) / 2;
+        if (gen->zipf_cdf[mid] < u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low * 0x9E3779B97F4A7C15UL % gen->blocks;
+}
+
+
+/**
+ * Set up a generator over footprint bytes of data
+*/
+void synthetic_init(SyntheticTrace* gen, int kind, unsigned long int footprint, unsigned long int seed) {
+    memset(gen, 0, sizeof(*gen));
+    gen->kind = kind;
+    gen->blocks = footprint / SYNTH_BLOCK ? footprint / SYNTH_BLOCK : 1;
+    gen->state = seed ? seed : 1;
+    gen->pc = SYNTH_CODE_BASE;
+
+    if (kind == SYNTH_ZIPF || kind == SYNTH_MIXED) {
+        gen->zipf_cdf = malloc(gen->blocks * sizeof(double));
+        if (!gen->zipf_cdf) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        double total = 0;
+        for (unsigned long int r = 0; r < gen->blocks; r++) {
+            total += 1.0 / pow(r + 1, SYNTH_ZIPF_EXPONENT);
+            gen->zipf_cdf[r] = total;
+        }
+        for (unsigned long int r = 0; r < gen->blocks; r++) {
+            gen->zipf_cdf[r] /= total;
+        }
+    }
+
+    if (kind == SYNTH_POINTER_CHASE) {
+        // Sattolo's shuffle: a single cycle through every block
+        unsigned long int* order = malloc(gen->blocks * sizeof(unsigned long int));
+        gen->next = malloc(gen->blocks * sizeof(unsigned long int));
+        if (!order || !gen->next) {
+            fprintf(stderr, "Malloc failed\n");
+            exit(1);
+        }
+        for (unsigned long int b = 0; b < gen->blocks; b++) {
+            order[b] = b;
+        }
+        for (unsigned long int b = gen->blocks - 1; b > 0; b--) {
+            unsigned long int other = random_below(gen, b);
+            unsigned long int swap = order[b];
+            order[b] = order[other];
+            order[other] = swap;
+        }
+        for (unsigned long int b = 0; b < gen->blocks; b++) {
+            gen->next[order[b]] = order[(b + 1) % gen->blocks];
+        }
+        free(order);
+    }
+}
+
+
+/**
+ * A data read, or a write one time in SYNTH_WRITE_EVERY
+*/
+static void data_record(SyntheticTrace* gen, TraceRecord* record, unsigned long int block) {
+    record->operation = random_below(gen, SYNTH_WRITE_EVERY) == 0 ? '0' + MEMORY_WRITE : '0' + MEMORY_READ;
+    record->address = SYNTH_DATA_BASE + block * SYNTH_BLOCK + random_below(gen, SYNTH_BLOCK / SYNTH_WORD) * SYNTH_WORD;
+}
+
+
+/**
+ * Generate the next count references
+*/
+void synthetic_fill(SyntheticTrace* gen, TraceRecord* records, size_t count) {
+    unsigned long int words = gen->blocks * (SYNTH_BLOCK / SYNTH_WORD);
+    unsigned long int steps = gen->blocks * SYNTH_BLOCK / SYNTH_STRIDE_BYTES;
+
+    for (size_t i = 0; i < count; i++) {
+        TraceRecord* record = &records[i];
+        record->operation = '0' + MEMORY_READ;
+        record->value = 0;
+
+        switch (gen->kind) {
+        case SYNTH_SEQUENTIAL:
+            record->address = SYNTH_DATA_BASE + gen->position * SYNTH_WORD;
+            gen->position = (gen->position + 1) % words;
+            break;
+        case SYNTH_STRIDE:
+            record->address = SYNTH_DATA_BASE + gen->position * SYNTH_STRIDE_BYTES;
+            gen->position = steps ? (gen->position + 1) % steps : 0;
+            break;
+        case SYNTH_RANDOM:
+            data_record(gen, record, random_below(gen, gen->blocks));
+            break;
+        case SYNTH_ZIPF:
+            data_record(gen, record, zipf_block(gen));
+            break;
+        case SYNTH_POINTER_CHASE:
+            record->address = SYNTH_DATA_BASE + gen->position * SYNTH_BLOCK;
+            gen->position = gen->next[gen->position];
+            break;
+        case SYNTH_MIXED:
+            if (random_below(gen, SYNTH_DATA_EVERY) == 0) {
+                data_record(gen, record, zipf_block(gen));
+                break;
+            }
+            record->operation = '0' + INSTR_FETCH;
+            record->address = gen->pc;
+            gen->pc += 4;
+            if (random_below(gen, SYNTH_BASIC_BLOCK) == 0 || gen->pc >= SYNTH_CODE_BASE + SYNTH_CODE_SIZE) {
+                gen->pc = SYNTH_CODE_BASE + random_below(gen, SYNTH_CODE_SIZE / 4) * 4;
+            }
+            break;
+        }
+    }
+}
+
+
+/**
+ * Free a generator's tables
+*/
+void synthetic_free(SyntheticTrace* gen) {
+    free(gen->zipf_cdf);
+    free(gen->next);
+    memset(gen, 0, sizeof(*gen));
+}
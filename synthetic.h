@@ -0,0 +1,45 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include "./cache_simulator.h"
+
+// synthetic reference generators
+#define SYNTH_SEQUENTIAL    0   // reads walking the footprint a word at a time
+#define SYNTH_STRIDE        1   // reads walking it SYNTH_STRIDE_BYTES at a time
+#define SYNTH_RANDOM        2   // uniformly random blocks
+#define SYNTH_ZIPF          3   // Zipf distributed blocks, a few hot ones
+#define SYNTH_POINTER_CHASE 4   // one random cycle through every block
+#define SYNTH_MIXED         5   // instruction fetches with Zipf data references
+#define NUM_SYNTHETIC       6
+
+// where the data and the mixed generator's code live
+#define SYNTH_DATA_BASE 0x10000000UL
+#define SYNTH_CODE_BASE 0x400000UL
+#define SYNTH_CODE_SIZE (64 * 1024)
+
+#define SYNTH_BLOCK 64
+#define SYNTH_WORD 8
+#define SYNTH_STRIDE_BYTES (9 * SYNTH_BLOCK)    // not a power of two, so it reaches every set
+#define SYNTH_WRITE_EVERY 4                     // one data reference in 4 is a write (random, zipf, mixed)
+#define SYNTH_ZIPF_EXPONENT 0.99
+#define SYNTH_BASIC_BLOCK 8                     // mixed: average instructions between jumps
+#define SYNTH_DATA_EVERY 3                      // mixed: one data reference per 3 instructions
+
+// one generator's state, the same seed gives the same references
+typedef struct {
+    int kind;
+    unsigned long int blocks;       // footprint in SYNTH_BLOCK blocks
+    unsigned long int position;     // word, stride step or block reached
+    unsigned long int pc;           // mixed: next instruction
+    unsigned long int state;        // xorshift64*
+    double* zipf_cdf;               // zipf and mixed: P(rank <= r)
+    unsigned long int* next;        // pointer chase: block after each block
+} SyntheticTrace;
+
+int synthetic_parse(const char* name);
+const char* synthetic_name(int kind);
+void synthetic_init(SyntheticTrace* gen, int kind, unsigned long int footprint, unsigned long int seed);
+void synthetic_fill(SyntheticTrace* gen, TraceRecord* records, size_t count);
+void synthetic_free(SyntheticTrace* gen);
+
+#endif
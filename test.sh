@@ -1,4 +1,9 @@
 #!/bin/bash
 ./cache_simulator ./traces/013.spice2g6.din -m -a 2 
 ./cache_simulator ./traces/008.espresso.din -m -a 4
-./cache_simulator ./traces/008.espresso.din -m -a 8
\ No newline at end of file
+./cache_simulator ./traces/008.espresso.din -m -a 8
+
+# coalescing same-block references must not change the stats: --interval in ns simulates record by record
+diff <(./cache_simulator ./traces/008.espresso.din -m --classify-misses) \
+    <(./cache_simulator ./traces/008.espresso.din -m --classify-misses --interval=1e12ns:/tmp/coalesce_check.csv | sed "/^Wrote/,+1d") \
+    && echo "Coalesced and per-record stats match"
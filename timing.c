@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+
+#include "./timing.h"
+
+
+/**
+ * Empty every MSHR and the issue window
+*/
+void timing_reset(TimingModel* model, int window, const int mshrs[NUM_MSHR_FILES]) {
+    memset(model, 0, sizeof(*model));
+    model->window = window;
+    model->last_issue = -TIMING_ISSUE_INTERVAL;
+    for (int f = 0; f < NUM_MSHR_FILES; f++) {
+        model->files[f].count = mshrs[f];
+    }
+}
+
+
+/**
+ * MSHR still fetching block at time, -1 if none
+*/
+static int mshr_pending(const MshrFile* file, unsigned long int block, double time) {
+    for (int i = 0; i < file->count; i++) {
+        if (file->free_at[i] > time && file->block[i] == block) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * MSHR that frees up first
+*/
+static int mshr_earliest(const MshrFile* file) {
+    int earliest = 0;
+    for (int i = 1; i < file->count; i++) {
+        if (file->free_at[i] < file->free_at[earliest]) {
+            earliest = i;
+        }
+    }
+    return earliest;
+}
+
+
+/**
+ * Time one access from what the serial model did with it: latency is how far
+ * it moved simulation_clock, missed the MSHR_* files of the levels it missed
+ * in (1 << file), l1 the file of its L1.
+ * Accesses issue in order one TIMING_ISSUE_INTERVAL apart, and no sooner than
+ * the access window before them completed. A miss holds an MSHR in every
+ * level it missed in from issue to completion, and can't issue (nor can
+ * anything after it) until each of those levels has one free; an access to
+ * a block its L1 is still fetching completes with that fetch instead. With
+ * a window of 1 this is the serial clock.
+*/
+void timing_access(TimingModel* model, TimingStats* stats, int l1, unsigned int missed,
+                   unsigned long int block, double latency) {
+    double issue = model->last_issue + TIMING_ISSUE_INTERVAL;
+    double* slot = &model->completions[model->head];
+    if (*slot > issue) {
+        issue = *slot;
+    }
+    double complete = issue + latency;
+
+    int pending = mshr_pending(&model->files[l1], block, issue);
+    if (pending >= 0) {
+        // secondary miss
+        stats->merged++;
+        if (model->files[l1].free_at[pending] > complete) {
+            complete = model->files[l1].free_at[pending];
+        }
+    } else if (missed) {
+        int entries[NUM_MSHR_FILES];
+        double stalled = issue;
+        for (int f = 0; f < NUM_MSHR_FILES; f++) {
+            if (missed & (1u << f)) {
+                entries[f] = mshr_earliest(&model->files[f]);
+                if (model->files[f].free_at[entries[f]] > issue) {
+                    issue = model->files[f].free_at[entries[f]];
+                }
+            }
+        }
+        complete = issue + latency;
+        for (int f = 0; f < NUM_MSHR_FILES; f++) {
+            if (missed & (1u << f)) {
+                model->files[f].block[entries[f]] = block;
+                model->files[f].free_at[entries[f]] = complete;
+            }
+        }
+
+        stats->misses++;
+        stats->mshr_stall += issue - stalled;
+        stats->miss_latency += latency;
+
+        // issues are in order, so the outstanding time only grows at its end
+        double from = issue > model->covered_until ? issue : model->covered_until;
+        if (complete > from) {
+            stats->miss_busy += complete - from;
+            model->covered_until = complete;
+        }
+    }
+
+    *slot = complete;
+    model->head = (model->head + 1) % model->window;
+    model->last_issue = issue;
+    if (complete > stats->clock) {
+        stats->clock = complete;
+    }
+}
+
+
+/**
+ * Add one run's timing into another's, clocks add up like the serial one
+*/
+void add_timing_stats(TimingStats* total, const TimingStats* stats) {
+    total->clock += stats->clock;
+    total->misses += stats->misses;
+    total->merged += stats->merged;
+    total->miss_latency += stats->miss_latency;
+    total->miss_busy += stats->miss_busy;
+    total->mshr_stall += stats->mshr_stall;
+}
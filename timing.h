@@ -0,0 +1,52 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+// non-blocking timing model, on with issue-window, the serial
+// simulation_clock is kept either way
+#define MAX_ISSUE_WINDOW 256    // accesses in flight at most
+#define DEFAULT_MSHRS    8      // per level, set with <level>-mshrs
+#define MAX_MSHRS        64
+#define TIMING_ISSUE_INTERVAL 0.5   // ns between two accesses issuing, one L1 cycle
+
+// MSHR files, one per level
+#define MSHR_L1I 0
+#define MSHR_L1D 1
+#define MSHR_L2  2
+#define MSHR_L3  3
+#define NUM_MSHR_FILES 4
+
+// miss status holding registers of one level: the block each one fetches
+// and when it's free again
+typedef struct {
+    int count;
+    unsigned long int block[MAX_MSHRS];
+    double free_at[MAX_MSHRS];
+} MshrFile;
+
+// in order issue of up to window accesses at a time, plain data so
+// checkpoints can copy it
+typedef struct {
+    int window;
+    int head;
+    double completions[MAX_ISSUE_WINDOW];   // ring, completion of the access window back
+    double last_issue;
+    double covered_until;                   // end of the time some miss was outstanding
+    MshrFile files[NUM_MSHR_FILES];
+} TimingModel;
+
+// what the non-blocking model measured
+typedef struct {
+    double clock;               // completion of the last access to complete
+    unsigned long int misses;   // primary misses, each held an MSHR
+    unsigned long int merged;   // secondary misses to a block an MSHR was fetching
+    double miss_latency;        // issue to completion of the primary misses, summed
+    double miss_busy;           // time at least one miss was outstanding
+    double mshr_stall;          // time misses waited for a free MSHR before issuing
+} TimingStats;
+
+void timing_reset(TimingModel* model, int window, const int mshrs[NUM_MSHR_FILES]);
+void timing_access(TimingModel* model, TimingStats* stats, int l1, unsigned int missed,
+                   unsigned long int block, double latency);
+void add_timing_stats(TimingStats* total, const TimingStats* stats);
+
+#endif
@@ -0,0 +1,517 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "./trace.h"
+#include "./profile.h"
+
+
+// hex digit value + 1, 0 for anything that is not a hex digit
+static const unsigned char hex_table[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+    ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+// longest hex field that still fits an unsigned long
+#define MAX_HEX_DIGITS (2 * sizeof(unsigned long int))
+
+
+/**
+ * Map a --reader name to a backend
+*/
+int trace_parse_reader(const char* name) {
+    if (strcmp(name, "stdio") == 0) {
+        return READER_STDIO;
+    }
+    if (strcmp(name, "mmap") == 0) {
+        return READER_MMAP;
+    }
+    return -1;
+}
+
+
+/**
+ * Map the whole file read-only.
+ * Returns 0 on success, -1 if the file can't be opened or mapped.
+*/
+static int map_file(TraceReader* reader, const char* filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // empty trace, nothing to map
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    reader->map = map;
+    reader->map_size = st.st_size;
+    reader->cursor = map;
+    reader->end = reader->cursor + st.st_size;
+
+    return 0;
+}
+
+
+/**
+ * Read a little endian integer
+*/
+static unsigned long int load_le(const unsigned char* p, int bytes) {
+    unsigned long int value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+
+/**
+ * Store a little endian integer
+*/
+static void store_le(unsigned char* p, unsigned long int value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+
+/**
+ * Check the binary header of a mapped file and switch to the binary backend.
+ * Returns 0 if the header is usable, -1 if it is from a newer version.
+*/
+static int open_binary(TraceReader* reader) {
+    const unsigned char* header = (const unsigned char*) reader->cursor;
+    if (load_le(header + 4, 4) != TRACE_VERSION) {
+        return -1;
+    }
+
+    reader->kind = READER_BINARY;
+    reader->records_left = load_le(header + 8, 8);
+    reader->cursor += TRACE_HEADER_SIZE;
+    return 0;
+}
+
+
+/**
+ * Does the mapping start with a binary trace header
+*/
+static int is_binary(const TraceReader* reader) {
+    return reader->end - reader->cursor >= TRACE_HEADER_SIZE
+        && memcmp(reader->cursor, TRACE_MAGIC, 4) == 0;
+}
+
+
+/**
+ * Open a trace file.
+ * Binary traces are detected from their header and always mapped.
+ * Returns 0 on success, -1 if the file can't be opened or mapped.
+*/
+int trace_open(TraceReader* reader, const char* filename, int kind) {
+    PROFILE_SCOPE(PROFILE_TRACE_IO);
+    memset(reader, 0, sizeof(*reader));
+    reader->kind = kind;
+
+    if (kind == READER_STDIO) {
+        reader->file = fopen(filename, "r");
+        if (reader->file == NULL) {
+            return -1;
+        }
+
+        char magic[4];
+        size_t got = fread(magic, 1, sizeof(magic), reader->file);
+        if (got < sizeof(magic) || memcmp(magic, TRACE_MAGIC, 4) != 0) {
+            rewind(reader->file);
+            return 0;
+        }
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+
+    if (map_file(reader, filename) != 0) {
+        return -1;
+    }
+    if (is_binary(reader)) {
+        return open_binary(reader);
+    }
+
+    reader->kind = READER_MMAP;
+    return 0;
+}
+
+
+/**
+ * Close a trace file
+*/
+void trace_close(TraceReader* reader) {
+    PROFILE_SCOPE(PROFILE_TRACE_IO);
+    if (reader->file) {
+        fclose(reader->file);
+    }
+    if (reader->map) {
+        munmap((void*) reader->map, reader->map_size);
+    }
+    memset(reader, 0, sizeof(*reader));
+}
+
+
+/**
+ * Bytes in the open trace file
+*/
+static unsigned long int trace_size(const TraceReader* reader) {
+    if (reader->file) {
+        struct stat st;
+        return fstat(fileno(reader->file), &st) == 0 ? (unsigned long int) st.st_size : 0;
+    }
+    return reader->map_size;
+}
+
+
+/**
+ * Where the reader is, to resume from with trace_seek
+*/
+void trace_tell(const TraceReader* reader, TracePosition* position) {
+    memset(position, 0, sizeof(*position));
+    position->binary = reader->kind == READER_BINARY;
+    position->size = trace_size(reader);
+    position->offset = reader->file ? (unsigned long int) ftell(reader->file)
+        : (unsigned long int) (reader->cursor - reader->map);
+    position->line = reader->line;
+    position->records_left = reader->records_left;
+    memcpy(position->last_address, reader->last_address, sizeof(position->last_address));
+}
+
+
+/**
+ * Move a freshly opened reader to a position trace_tell gave for the same file.
+ * Returns 0 on success, -1 if the position can't be from this file.
+*/
+int trace_seek(TraceReader* reader, const TracePosition* position) {
+    PROFILE_SCOPE(PROFILE_TRACE_IO);
+    if (position->binary != (reader->kind == READER_BINARY) || position->size != trace_size(reader)
+        || position->offset > position->size) {
+        return -1;
+    }
+
+    if (reader->file) {
+        if (fseek(reader->file, position->offset, SEEK_SET) != 0) {
+            return -1;
+        }
+    } else if (reader->map) {
+        reader->cursor = reader->map + position->offset;
+    }
+    reader->line = position->line;
+    reader->records_left = position->records_left;
+    memcpy(reader->last_address, position->last_address, sizeof(reader->last_address));
+    return 0;
+}
+
+
+/**
+ * Find the end of the current line.
+ * Lines are short, so one 16 byte compare usually finds it.
+*/
+static const char* find_line_end(const char* p, const char* end) {
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    const char* newline_at = memchr(p, '\n', end - p);
+    return newline_at ? newline_at : end;
+}
+
+
+/**
+ * Skip blanks inside a line
+*/
+static const char* skip_blanks(const char* p, const char* eol) {
+    while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+
+/**
+ * Parse one hex field, same as %lx: optional sign and 0x prefix, a
+ * negative value wraps like strtoul, and one too big for an unsigned long
+ * (leading zeros aside) saturates to ULONG_MAX.
+ * Returns NULL if there are no digits.
+*/
+static const char* parse_hex(const char* p, const char* eol, unsigned long int* out) {
+    int negative = 0;
+    if (p < eol && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    // a bare "0x" reads as 0, like glibc's scanf
+    const char* start = p;
+    if (eol - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+    }
+    while (p < eol && *p == '0') {
+        p++;
+    }
+    const char* significant = p;
+    unsigned long int value = 0;
+    unsigned int digit;
+    while (p < eol && (digit = hex_table[(unsigned char) *p]) != 0) {
+        value = (value << 4) | (digit - 1);
+        p++;
+    }
+
+    if (p == start) {
+        return NULL;
+    }
+
+    if ((size_t) (p - significant) > MAX_HEX_DIGITS) {
+        *out = ULONG_MAX;
+    } else {
+        *out = negative ? -value : value;
+    }
+    return p;
+}
+
+
+/**
+ * Read the next record from the mapped file
+*/
+static int mmap_next(TraceReader* reader, TraceRecord* record) {
+    const char* p = reader->cursor;
+    const char* end = reader->end;
+
+    // whitespace between records, like the trailing "\n" of the fscanf format
+    while (p < end && (*p == '\n' || *p == ' ' || *p == '\t' || *p == '\r')) {
+        if (*p == '\n') {
+            reader->line++;
+        }
+        p++;
+    }
+    if (p == end) {
+        reader->cursor = p;
+        return TRACE_EOF;
+    }
+
+    const char* eol = find_line_end(p, end);
+    reader->line++;
+    reader->cursor = eol < end ? eol + 1 : end;
+
+    record->operation = *p++;
+    p = skip_blanks(p, eol);
+    p = parse_hex(p, eol, &record->address);
+    if (p == NULL) {
+        return TRACE_MALFORMED;
+    }
+    p = skip_blanks(p, eol);
+    p = parse_hex(p, eol, &record->value);
+    if (p == NULL || skip_blanks(p, eol) != eol) {
+        return TRACE_MALFORMED;
+    }
+
+    return TRACE_RECORD;
+}
+
+
+/**
+ * Decode one varint, NULL if it runs off the end
+*/
+static const unsigned char* read_varint(const unsigned char* p, const unsigned char* end,
+                                        unsigned long int* out) {
+    unsigned long int value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        value |= (unsigned long int) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *out = value;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Read the next record from a binary trace
+*/
+static int binary_next(TraceReader* reader, TraceRecord* record) {
+    if (reader->records_left == 0) {
+        return TRACE_EOF;
+    }
+
+    const unsigned char* p = (const unsigned char*) reader->cursor;
+    const unsigned char* end = (const unsigned char*) reader->end;
+    reader->line++;
+    if (p == end) {
+        return TRACE_MALFORMED;
+    }
+
+    unsigned char tag = *p++;
+    int stream = tag & TRACE_TAG_OPCODE;
+
+    // zigzag delta against the previous address of this opcode
+    unsigned long int delta;
+    p = read_varint(p, end, &delta);
+    if (p == NULL) {
+        return TRACE_MALFORMED;
+    }
+    reader->last_address[stream] += (delta >> 1) ^ -(delta & 1);
+
+    record->operation = '0' + stream;
+    record->address = reader->last_address[stream];
+    record->value = 0;
+    if (tag & TRACE_TAG_VALUE) {
+        p = read_varint(p, end, &record->value);
+        if (p == NULL) {
+            return TRACE_MALFORMED;
+        }
+    }
+
+    reader->cursor = (const char*) p;
+    reader->records_left--;
+    return TRACE_RECORD;
+}
+
+
+/**
+ * Read the next record.
+ * Returns TRACE_RECORD, TRACE_EOF or TRACE_MALFORMED.
+*/
+int trace_next(TraceReader* reader, TraceRecord* record) {
+    PROFILE_SCOPE(PROFILE_TRACE_PARSE);
+    if (reader->kind == READER_BINARY) {
+        return binary_next(reader, record);
+    }
+
+    if (reader->kind == READER_MMAP) {
+        if (reader->cursor == reader->end) {
+            return TRACE_EOF;
+        }
+        return mmap_next(reader, record);
+    }
+
+    int matched = fscanf(reader->file, "%c %lx %lx\n",
+        &record->operation, &record->address, &record->value);
+    if (matched == 3) {
+        reader->line++;
+        return TRACE_RECORD;
+    }
+    if (matched == EOF) {
+        return TRACE_EOF;
+    }
+    reader->line++;
+    return TRACE_MALFORMED;
+}
+
+
+/**
+ * Write the binary header with the current record count
+*/
+static int write_header(TraceWriter* writer) {
+    unsigned char header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_MAGIC, 4);
+    store_le(header + 4, TRACE_VERSION, 4);
+    store_le(header + 8, writer->count, 8);
+    return fwrite(header, 1, sizeof(header), writer->file) == sizeof(header) ? 0 : -1;
+}
+
+
+/**
+ * Append a varint to the buffer, returns the new end
+*/
+static unsigned char* put_varint(unsigned char* p, unsigned long int value) {
+    while (value >= 0x80) {
+        *p++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+
+/**
+ * Create a binary trace.
+ * The record count in the header is filled in by trace_writer_close.
+*/
+int trace_writer_open(TraceWriter* writer, const char* filename) {
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(filename, "wb");
+    if (writer->file == NULL) {
+        return -1;
+    }
+    return write_header(writer);
+}
+
+
+/**
+ * Append one record.
+ * Returns -1 for opcodes the format can't hold or on a write error.
+*/
+int trace_write(TraceWriter* writer, const TraceRecord* record) {
+    int stream = record->operation - '0';
+    if (stream < 0 || stream > TRACE_TAG_OPCODE) {
+        return -1;
+    }
+
+    unsigned char buffer[1 + 2 * 10];
+    unsigned char* p = buffer;
+
+    unsigned long int delta = record->address - writer->last_address[stream];
+    writer->last_address[stream] = record->address;
+
+    *p++ = stream | (record->value ? TRACE_TAG_VALUE : 0);
+    p = put_varint(p, (delta << 1) ^ -(delta >> 63));
+    if (record->value) {
+        p = put_varint(p, record->value);
+    }
+
+    writer->count++;
+    return fwrite(buffer, 1, p - buffer, writer->file) == (size_t) (p - buffer) ? 0 : -1;
+}
+
+
+/**
+ * Finish a binary trace, patching the record count into the header
+*/
+int trace_writer_close(TraceWriter* writer) {
+    int status = 0;
+    if (fseek(writer->file, 0, SEEK_SET) != 0 || write_header(writer) != 0) {
+        status = -1;
+    }
+    if (fclose(writer->file) != 0) {
+        status = -1;
+    }
+    writer->file = NULL;
+    return status;
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// trace reader backends
+#define READER_STDIO 0
+#define READER_MMAP  1
+#define READER_BINARY 2     // picked automatically from the file header
+
+// trace_next results
+#define TRACE_EOF        0
+#define TRACE_RECORD     1
+#define TRACE_MALFORMED -1
+
+// packed binary trace format
+//
+// header: "DINB" magic, u32 version, u64 record count (little endian)
+// record: one tag byte (opcode in the low nibble, TRACE_TAG_* flags above),
+//         zigzag varint address delta from the last address with the same
+//         opcode, then a varint value if TRACE_TAG_VALUE is set
+#define TRACE_MAGIC        "DINB"
+#define TRACE_VERSION      1
+#define TRACE_HEADER_SIZE  16
+#define TRACE_TAG_OPCODE   0x0f
+#define TRACE_TAG_VALUE    0x10
+#define TRACE_NUM_STREAMS  16
+
+// one decoded Dinero record
+typedef struct {
+    char operation;
+    unsigned long int address;
+    unsigned long int value;
+} TraceRecord;
+
+// open trace file, read through one of the backends
+typedef struct {
+    int kind;
+    unsigned long int line;     // line of the last record returned
+
+    // stdio backend
+    FILE* file;
+
+    // mmap backend
+    const char* map;
+    size_t map_size;
+    const char* cursor;
+    const char* end;
+
+    // binary backend
+    unsigned long int records_left;
+    unsigned long int last_address[TRACE_NUM_STREAMS];
+} TraceReader;
+
+// binary trace being written
+typedef struct {
+    FILE* file;
+    unsigned long int count;
+    unsigned long int last_address[TRACE_NUM_STREAMS];
+} TraceWriter;
+
+// where a reader is in its trace, to come back to later (checkpoint.h)
+typedef struct {
+    int binary;                 // read through the binary backend
+    unsigned long int size;     // bytes in the trace file
+    unsigned long int offset;   // byte offset of the next record
+    unsigned long int line;
+    unsigned long int records_left;
+    unsigned long int last_address[TRACE_NUM_STREAMS];
+} TracePosition;
+
+int trace_open(TraceReader* reader, const char* filename, int kind);
+int trace_next(TraceReader* reader, TraceRecord* record);
+void trace_close(TraceReader* reader);
+void trace_tell(const TraceReader* reader, TracePosition* position);
+int trace_seek(TraceReader* reader, const TracePosition* position);
+int trace_parse_reader(const char* name);
+
+int trace_writer_open(TraceWriter* writer, const char* filename);
+int trace_write(TraceWriter* writer, const TraceRecord* record);
+int trace_writer_close(TraceWriter* writer);
+
+#endif
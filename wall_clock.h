@@ -0,0 +1,16 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <time.h>
+
+
+/**
+ * Seconds on the monotonic clock
+*/
+static inline double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif